@@ -3,3 +3,73 @@
 
 #include "AdaptiveSplineComponent.h"
 
+#include "SplineHelperLog.h"
+#include "SplinePointImporter.h"
+
+bool UAdaptiveSplineComponent::ImportPointsFromFile(const FString& FilePath, float Tolerance, ESplineCoordinateSpace::Type CoordinateSpace)
+{
+	// The existing points are only replaced once the whole file was read
+	TArray<FVector> Points;
+	FStreamingPolylineSimplifier Simplifier(Tolerance, [&Points](const FVector& Point)
+	{
+		Points.Add(Point);
+	});
+
+	const bool bSuccess = FSplinePointImporter::ImportFile(FilePath, [&Simplifier](const FVector& Point)
+	{
+		Simplifier.AddPoint(Point);
+	});
+	Simplifier.Finish();
+
+	if (!bSuccess || Points.IsEmpty())
+	{
+		UE_LOG(LogSplineHelper, Warning, TEXT("Keeping the spline points, no points could be imported from %s"), *FilePath);
+		return false;
+	}
+
+	Modify();
+	SetSplinePoints(Points, CoordinateSpace, true);
+
+	UE_LOG(LogSplineHelper, Log, TEXT("Imported %d of %d points from %s"), Simplifier.GetNumPointsEmitted(), Simplifier.GetNumPointsRead(), *FilePath);
+	return true;
+}
+
+void UAdaptiveSplineComponent::RemoveFirstSplinePoints(int32 NumPoints, bool bUpdateSpline)
+{
+	NumPoints = FMath::Min(NumPoints, GetNumberOfSplinePoints());
+	if (NumPoints <= 0)
+	{
+		return;
+	}
+
+	SplineCurves.Position.Points.RemoveAt(0, NumPoints);
+	SplineCurves.Rotation.Points.RemoveAt(0, NumPoints);
+	SplineCurves.Scale.Points.RemoveAt(0, NumPoints);
+
+	// Input keys stay sequential from 0, the same renumbering RemoveSplinePoint does
+	for (int32 nPoint = 0; nPoint < SplineCurves.Position.Points.Num(); ++nPoint)
+	{
+		SplineCurves.Position.Points[nPoint].InVal -= NumPoints;
+		SplineCurves.Rotation.Points[nPoint].InVal -= NumPoints;
+		SplineCurves.Scale.Points[nPoint].InVal -= NumPoints;
+	}
+
+	if (USplineMetadata* Metadata = GetSplinePointsMetadata())
+	{
+		for (int32 nPoint = 0; nPoint < NumPoints; ++nPoint)
+		{
+			Metadata->RemovePoint(0);
+		}
+	}
+
+	if (bUpdateSpline)
+	{
+		UpdateSpline();
+	}
+}
+
+void UAdaptiveSplineComponent::UpdateSpline()
+{
+	Super::UpdateSpline();
+	++SplineRevision;
+}
@@ -245,12 +245,12 @@ void FAdaptiveSplineDetails::SimplifyComponentsBetweenKeys(USplineComponent* Spl
 	SplineComponent->UpdateSpline();
 }
 
-FSplineComponentVisualizer* GetFirstValidSplineVisualizer()
+FSplineComponentVisualizer* GetFirstValidSplineVisualizer(const USplineComponent* SplineComponent)
 {
 	if (GUnrealEd)
 	{
-		TSharedPtr<FComponentVisualizer> Visualizer = GUnrealEd->FindComponentVisualizer(
-			USplineComponent::StaticClass()->GetFName());
+		// Adaptive splines use their own visualizer, which derives from the spline one and holds their key selection
+		TSharedPtr<FComponentVisualizer> Visualizer = GUnrealEd->FindComponentVisualizer(SplineComponent->GetClass());
 		if (Visualizer.IsValid())
 		{
 			return static_cast<FSplineComponentVisualizer*>(Visualizer.Get());
@@ -273,8 +273,8 @@ void FAdaptiveSplineDetails::RequestWork(bool bSubdiv)
 
 		if (USplineComponent* SplineComponent = Cast<USplineComponent>(ObjectsBeingCustomized[0].Get()))
 		{
-			const FSplineComponentVisualizer* SplineVisualizer = GetFirstValidSplineVisualizer();
-			const TSet<int32>& SelectedKeys = SplineVisualizer->GetSelectedKeys();
+			const FSplineComponentVisualizer* SplineVisualizer = GetFirstValidSplineVisualizer(SplineComponent);
+			const TSet<int32> SelectedKeys = SplineVisualizer ? SplineVisualizer->GetSelectedKeys() : TSet<int32>();
 
 			if (SelectedKeys.Num() < 2)
 			{
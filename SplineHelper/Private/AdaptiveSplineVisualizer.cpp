@@ -0,0 +1,145 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AdaptiveSplineVisualizer.h"
+
+#include "AdaptiveSplineComponent.h"
+#include "EditorViewportClient.h"
+#include "SceneManagement.h"
+
+IMPLEMENT_HIT_PROXY(HAdaptiveSplineKeyProxy, HComponentVisProxy);
+
+void FAdaptiveSplineVisualizer::DrawVisualization(const UActorComponent* Component, const FSceneView* View, FPrimitiveDrawInterface* PDI)
+{
+	const UAdaptiveSplineComponent* SplineComp = Cast<const UAdaptiveSplineComponent>(Component);
+	if (!SplineComp || SplineComp->GetNumberOfSplinePoints() <= DecimationThreshold)
+	{
+		FSplineComponentVisualizer::DrawVisualization(Component, View, PDI);
+		return;
+	}
+
+	const int32 KeyStride = ComputeKeyStride(SplineComp, View);
+
+	if (CachedBatches.Num() > MaxCachedBatches)
+	{
+		for (auto It = CachedBatches.CreateIterator(); It; ++It)
+		{
+			if (!It.Key().ResolveObjectPtr())
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+
+	// The batch only depends on the spline data, its transform and the decimation level, so it survives camera moves
+	FCachedLineBatch& Batch = CachedBatches.FindOrAdd(FObjectKey(SplineComp));
+	if (Batch.Revision != SplineComp->GetSplineRevision() || Batch.KeyStride != KeyStride || !Batch.ComponentTransform.Equals(SplineComp->GetComponentTransform()))
+	{
+		BuildLineBatch(SplineComp, KeyStride, Batch);
+	}
+
+	const FLinearColor LineColor = SplineComp->EditorUnselectedSplineSegmentColor;
+	const FLinearColor KeyColor = SplineComp->EditorUnselectedSplineSegmentColor;
+	const FLinearColor SelectedColor = SplineComp->EditorSelectedSplineSegmentColor;
+
+	PDI->SetHitProxy(nullptr);
+	for (int32 nPoint = 1; nPoint < Batch.Points.Num(); ++nPoint)
+	{
+		PDI->DrawLine(Batch.Points[nPoint - 1], Batch.Points[nPoint], LineColor, SDPG_Foreground);
+	}
+
+	for (int32 nPoint = 0; nPoint < Batch.Keys.Num(); ++nPoint)
+	{
+		PDI->SetHitProxy(new HAdaptiveSplineKeyProxy(Component, Batch.Keys[nPoint]));
+		PDI->DrawPoint(Batch.Points[nPoint], KeyColor, KeyPointSize, SDPG_Foreground);
+	}
+
+	// Selected keys are always drawn, even when decimation skipped them
+	if (GetEditedSplineComponent() == SplineComp)
+	{
+		for (const int32 SelectedKey : GetSelectedKeys())
+		{
+			if (SelectedKey < SplineComp->GetNumberOfSplinePoints())
+			{
+				PDI->SetHitProxy(new HAdaptiveSplineKeyProxy(Component, SelectedKey));
+				PDI->DrawPoint(SplineComp->GetLocationAtSplinePoint(SelectedKey, ESplineCoordinateSpace::World), SelectedColor, SelectedKeyPointSize, SDPG_Foreground);
+			}
+		}
+	}
+
+	PDI->SetHitProxy(nullptr);
+}
+
+bool FAdaptiveSplineVisualizer::VisProxyHandleClick(FEditorViewportClient* InViewportClient, HComponentVisProxy* VisProxy, const FViewportClick& Click)
+{
+	if (VisProxy && VisProxy->Component.IsValid() && VisProxy->IsA(HAdaptiveSplineKeyProxy::StaticGetType()))
+	{
+		const HAdaptiveSplineKeyProxy* KeyProxy = static_cast<HAdaptiveSplineKeyProxy*>(VisProxy);
+		const USplineComponent* SplineComp = CastChecked<const USplineComponent>(VisProxy->Component.Get());
+
+		check(SelectionState);
+		SelectionState->Modify();
+		SelectionState->SetSplinePropertyPath(FComponentPropertyPath(SplineComp));
+		SelectionState->ClearSelectedSegmentIndex();
+		SelectionState->ClearSelectedTangentHandle();
+		ChangeSelectionState(KeyProxy->KeyIndex, Click.IsControlDown());
+		return true;
+	}
+
+	return FSplineComponentVisualizer::VisProxyHandleClick(InViewportClient, VisProxy, Click);
+}
+
+int32 FAdaptiveSplineVisualizer::ComputeKeyStride(const USplineComponent* SplineComp, const FSceneView* View) const
+{
+	const int32 NumSegments = SplineComp->GetNumberOfSplineSegments();
+	const FBoxSphereBounds& Bounds = SplineComp->Bounds;
+
+	if (NumSegments < 1 || Bounds.SphereRadius <= UE_KINDA_SMALL_NUMBER)
+	{
+		return 1;
+	}
+
+	// Approximate the on screen length of the spline from the projected size of its bounds
+	const float ScreenFraction = ComputeBoundsScreenSize(Bounds.Origin, Bounds.SphereRadius, *View);
+	const float BoundsPixels = ScreenFraction * View->UnscaledViewRect.Width();
+	const float WorldLength = SplineComp->GetSplineLength() * SplineComp->GetComponentTransform().GetMaximumAxisScale();
+	const float SplinePixels = BoundsPixels * WorldLength / (2.0f * Bounds.SphereRadius);
+
+	const int32 MaxSegments = FMath::Max(FMath::CeilToInt(SplinePixels / PixelsPerSegment), 1);
+	const int32 Stride = FMath::DivideAndRoundUp(NumSegments, MaxSegments);
+
+	// Power of two strides keep the cached batch stable while zooming
+	return FMath::RoundUpToPowerOfTwo(static_cast<uint32>(FMath::Max(Stride, 1)));
+}
+
+void FAdaptiveSplineVisualizer::BuildLineBatch(const USplineComponent* SplineComp, int32 KeyStride, FCachedLineBatch& Batch) const
+{
+	const UAdaptiveSplineComponent* AdaptiveSplineComp = CastChecked<const UAdaptiveSplineComponent>(SplineComp);
+	const int32 NumPoints = SplineComp->GetNumberOfSplinePoints();
+
+	Batch.Revision = AdaptiveSplineComp->GetSplineRevision();
+	Batch.KeyStride = KeyStride;
+	Batch.ComponentTransform = SplineComp->GetComponentTransform();
+	Batch.Points.Reset();
+	Batch.Keys.Reset();
+
+	for (int32 Key = 0; Key < NumPoints; Key += KeyStride)
+	{
+		Batch.Keys.Add(Key);
+	}
+
+	if (Batch.Keys.Last() != NumPoints - 1)
+	{
+		Batch.Keys.Add(NumPoints - 1);
+	}
+
+	for (const int32 Key : Batch.Keys)
+	{
+		Batch.Points.Add(SplineComp->GetLocationAtSplinePoint(Key, ESplineCoordinateSpace::World));
+	}
+
+	if (SplineComp->IsClosedLoop())
+	{
+		Batch.Points.Add(Batch.Points[0]);
+	}
+}
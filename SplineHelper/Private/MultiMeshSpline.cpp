@@ -3,7 +3,15 @@
 
 #include "MultiMeshSpline.h"
 
+#include "SplineBatchEvaluator.h"
+#include "SplineHelperLog.h"
+#include "SplineMeshInstancing.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/Unique.h"
+#include "AI/NavigationSystemBase.h"
+#include "Components/InstancedStaticMeshComponent.h"
 #include "Components/SplineMeshComponent.h"
+#include "Serialization/MemoryWriter.h"
 
 AMultiMeshSpline::AMultiMeshSpline()
 {
@@ -15,268 +23,1771 @@ AMultiMeshSpline::AMultiMeshSpline()
 	RootComponent = Spline;
 }
 
-void AMultiMeshSpline::GenerateMeshesByPoints()
+void AMultiMeshSpline::GatherSegmentKeys(const FSplineMeshLayer& Layer, float KeysPerTime, float StartKey, float EndKey, TArray<float>& SegmentKeys) const
 {
-	const int32 MaxPoints = Spline->GetNumberOfSplinePoints();
+	switch (Layer.SplineType)
+	{
+		case Point: GatherSegmentKeysByPoints(StartKey, EndKey, SegmentKeys); break;
+		case TimeBased: GatherSegmentKeysByTime(Layer.TimeInterval * KeysPerTime, StartKey, EndKey, SegmentKeys); break;
+		case Steepness: GatherSegmentKeysBySteepness(Layer, Layer.TimeInterval * KeysPerTime, StartKey, EndKey, SegmentKeys); break;
+		case Deformation: GatherSegmentKeysByDeformation(Layer, StartKey, EndKey, SegmentKeys); break;
+	}
 
-	for (int32 Point = 0; Point < MaxPoints - 1; ++Point)
+	// Time based segments may overshoot the end, the curve is clamped there anyway and the next span starts right there
+	if (SegmentKeys.Num() > 0)
 	{
-		const float NextPoint = Point + 1;
-		const float Start = ConvertPointToTime(Point);
-		const float End = ConvertPointToTime(NextPoint);
-		CreateSplineMeshSegment(Start, End);
+		SegmentKeys.Last() = FMath::Min(SegmentKeys.Last(), EndKey);
 	}
 }
 
-void AMultiMeshSpline::GenerateMeshesByTime()
+void AMultiMeshSpline::GatherSegmentKeysByPoints(float StartKey, float EndKey, TArray<float>& SegmentKeys) const
 {
-	const float Start = 0;
-	const float End = Spline->Duration;
+	if (EndKey <= StartKey)
+	{
+		return;
+	}
 
-	for (float nCurrentPosition = Start; nCurrentPosition < End; nCurrentPosition += TimeInterval)
+	// Segments end exactly at the points, moving one point only reshapes the segments next to it
+	SegmentKeys.Add(StartKey);
+	for (int32 Point = FMath::FloorToInt32(StartKey) + 1; Point < EndKey; ++Point)
 	{
-		CreateSplineMeshSegment(nCurrentPosition, nCurrentPosition + TimeInterval);
+		SegmentKeys.Add(static_cast<float>(Point));
 	}
+	SegmentKeys.Add(EndKey);
 }
 
-void AMultiMeshSpline::GenerateMeshesBySteepness()
+void AMultiMeshSpline::GatherSegmentKeysByTime(float KeyInterval, float StartKey, float EndKey, TArray<float>& SegmentKeys) const
 {
-	const float Start = 0;
-	const float End = Spline->Duration;
-	TArray<float> TimePoints;
-
-	TimePoints.Add(Start);
-
-	for (float nCurrentPosition = Start; nCurrentPosition < End; nCurrentPosition += TimeInterval)
+	if (KeyInterval <= 0.0f)
 	{
-		const float NextPosition = FMath::Min(nCurrentPosition + TimeInterval, End);
-		FindSteepnessPoints(nCurrentPosition, NextPosition, MaxSteepnessThreshold, TimePoints);
+		return;
 	}
 
-	if (!TimePoints.Contains(End))
+	float nCurrentPosition = StartKey;
+	for (; nCurrentPosition < EndKey; nCurrentPosition += KeyInterval)
 	{
-		TimePoints.Add(End);
+		SegmentKeys.Add(nCurrentPosition);
 	}
 
-	TimePoints.Sort();
-
-	for (int32 i = 0; i < TimePoints.Num() - 1; i++)
+	if (SegmentKeys.Num() > 0)
 	{
-		CreateSplineMeshSegment(TimePoints[i], TimePoints[i + 1]);
+		SegmentKeys.Add(nCurrentPosition);
 	}
 }
 
-void AMultiMeshSpline::FindSteepnessPoints(float StartTime, float EndTime, float InMaxSteepness, TArray<float>& TimePoints)
+void AMultiMeshSpline::GatherSegmentKeysBySteepness(const FSplineMeshLayer& Layer, float KeyInterval, float StartKey, float EndKey, TArray<float>& SegmentKeys) const
 {
-	if (StartTime == EndTime)
+	if (KeyInterval <= 0.0f)
 	{
 		return;
 	}
 
-	const FVector StartTangent = Spline->GetTangentAtTime(StartTime, ESplineCoordinateSpace::Local).GetSafeNormal();
-	const FVector EndTangent = Spline->GetTangentAtTime(EndTime, ESplineCoordinateSpace::Local).GetSafeNormal();
+	SegmentKeys.Add(StartKey);
+
+	TArray<TPair<float, float>> Intervals;
+	for (float nCurrentPosition = StartKey; nCurrentPosition < EndKey; nCurrentPosition += KeyInterval)
+	{
+		Intervals.Emplace(nCurrentPosition, FMath::Min(nCurrentPosition + KeyInterval, EndKey));
+	}
 
-	const float Angle = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(StartTangent, EndTangent)));
+	// Intervals are halved breadth first while their end tangents differ too much, one batch evaluation per level
+	TArray<float> Keys;
+	TArray<FVector> Locations;
+	TArray<FVector> Tangents;
+	TArray<TPair<float, float>> NextIntervals;
 
-	if (Angle > InMaxSteepness)
+	while (Intervals.Num() > 0)
 	{
-		const float MidTime = (StartTime + EndTime) * 0.5f;
+		Keys.Reset();
+		for (const TPair<float, float>& Interval : Intervals)
+		{
+			Keys.Add(Interval.Key);
+			Keys.Add(Interval.Value);
+		}
+		FSplineBatchEvaluator::EvaluatePositionsAtInputKeys(Spline, Keys, Locations, Tangents);
+
+		NextIntervals.Reset();
+		for (int32 nInterval = 0; nInterval < Intervals.Num(); ++nInterval)
+		{
+			const float IntervalStart = Intervals[nInterval].Key;
+			const float IntervalEnd = Intervals[nInterval].Value;
+			const float MidKey = (IntervalStart + IntervalEnd) * 0.5f;
 
-		TimePoints.AddUnique(MidTime);
+			// Stops once the interval can't be split any further in float precision
+			if (MidKey <= IntervalStart || MidKey >= IntervalEnd)
+			{
+				continue;
+			}
 
-		FindSteepnessPoints(StartTime, MidTime, InMaxSteepness, TimePoints);
-		FindSteepnessPoints(MidTime, EndTime, InMaxSteepness, TimePoints);
+			const FVector StartTangent = Tangents[nInterval * 2].GetSafeNormal();
+			const FVector EndTangent = Tangents[nInterval * 2 + 1].GetSafeNormal();
+			const float Angle = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(StartTangent, EndTangent)));
+
+			if (Angle > Layer.MaxSteepnessThreshold)
+			{
+				SegmentKeys.Add(MidKey);
+				NextIntervals.Emplace(IntervalStart, MidKey);
+				NextIntervals.Emplace(MidKey, IntervalEnd);
+			}
+		}
+		Swap(Intervals, NextIntervals);
 	}
+
+	SegmentKeys.Add(EndKey);
+	SegmentKeys.Sort();
+	SegmentKeys.SetNum(Algo::Unique(SegmentKeys));
 }
 
-void AMultiMeshSpline::CreateSplineMeshSegment(float StartTime, float EndTime)
+void AMultiMeshSpline::GatherSegmentKeysByDeformation(const FSplineMeshLayer& Layer, float StartKey, float EndKey, TArray<float>& SegmentKeys) const
 {
-	USplineMeshComponent* Component = Cast<USplineMeshComponent>(AddComponentByClass(USplineMeshComponent::StaticClass(), true, GetActorTransform(), false));
-
-	if(!IsValid(Component))
+	if (EndKey <= StartKey)
 	{
 		return;
 	}
 
-	CreatedMeshes.Add(Component);
-	Component->SetStaticMesh(Mesh);
-	Component->SetMobility(EComponentMobility::Static);
-	const FVector StartPoint = Spline->GetLocationAtTime(StartTime, ESplineCoordinateSpace::Local);
-	const FVector EndPoint = Spline->GetLocationAtTime(EndTime, ESplineCoordinateSpace::Local);
-	const FVector StartTangent = Spline->GetTangentAtTime(StartTime, ESplineCoordinateSpace::Local);
-	const FVector EndTangent = Spline->GetTangentAtTime(EndTime, ESplineCoordinateSpace::Local);
-	const FVector StartScale = Spline->GetScaleAtTime(StartTime);
-	const FVector EndScale = Spline->GetScaleAtTime(EndTime);
-	const float StartRoll = Spline->GetRollAtTime(StartTime, ESplineCoordinateSpace::Local);
-	const float EndRoll = Spline->GetRollAtTime(EndTime, ESplineCoordinateSpace::Local);
-
-	Component->SetStartAndEnd(StartPoint, StartTangent, EndPoint, EndTangent);
-	Component->SetStartRoll(FMath::DegreesToRadians(StartRoll));
-	Component->SetEndRoll(FMath::DegreesToRadians(EndRoll));
-	Component->SetStartScale(FVector2D{ StartScale.Y, StartScale.Z });
-	Component->SetEndScale(FVector2D{ EndScale.Y, EndScale.Z });
-	Component->BodyInstance.CopyRuntimeBodyInstancePropertiesFrom(&this->BodyInstance);
-	Component->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepWorldTransform);
-}
+	const float MeshRadius = GetLayerCrossSectionRadius(Layer);
+	FSplineBatchSamples Scratch;
+	float Step = 1.0f;
 
-struct FPositionRange
-{
-	float Start;
-	float End;
-};
+	SegmentKeys.Add(StartKey);
 
-void AMultiMeshSpline::GenerateAdditionalMeshes()
-{
-	const int32 AdditionalMeshesNum = AdditionalMeshSettings.Num();
-	for (int32 nAdditionalMesh = 0; nAdditionalMesh < AdditionalMeshesNum; ++nAdditionalMesh)
+	// The greedy search restarts at every DeformationResyncKeys key, so an edit only moves the boundaries of the chunks it touches
+	const int32 FirstChunk = FMath::FloorToInt32(StartKey / DeformationResyncKeys);
+	const int32 LastChunk = FMath::CeilToInt32(EndKey / DeformationResyncKeys);
+
+	for (int32 nChunk = FirstChunk; nChunk < LastChunk; ++nChunk)
 	{
-		const FAdditionalMesh& CurrentAdditionalMesh = AdditionalMeshSettings[nAdditionalMesh];
-		const FAdditionalMeshInfo& CurrentMeshInfo = CurrentAdditionalMesh.InstanceInfo;
-		const FAdditionalMeshRepetitionParams& CurrentRepetitionInfo = CurrentAdditionalMesh.RepetitionInfo;
+		float SegmentStart = FMath::Max(StartKey, static_cast<float>(nChunk * DeformationResyncKeys));
+		const float ChunkEnd = FMath::Min(EndKey, static_cast<float>((nChunk + 1) * DeformationResyncKeys));
 
-		if(FMath::IsNearlyZero(CurrentRepetitionInfo.Repetition) || !IsValid(CurrentMeshInfo.Mesh) || !IsValid(CurrentMeshInfo.MeshClass))
+		while (SegmentStart < ChunkEnd)
 		{
-			continue;
-		}
+			// Grow the segment until it breaks the tolerance, then bisect between the last good and first bad end
+			float GoodEnd = SegmentStart;
+			float BadEnd = SegmentStart;
+			float Candidate = FMath::Min(SegmentStart + Step, ChunkEnd);
 
-		TArray<FPositionRange> PositionRanges;
-		switch (CurrentRepetitionInfo.Type)
-		{
-			case ERepetitionType::Always:
-			{
-				FPositionRange Range;
-				Range.Start = 0.0f;
-				Range.End = Spline->Duration;
-				PositionRanges.Add(Range);
-				break;
-			}
-			case ERepetitionType::BetweenTimeIntervals:
+			while (true)
 			{
-				const int32 nRanges = CurrentRepetitionInfo.Ranges.Num();
-				for (int32 nRange = 0; nRange < nRanges; ++nRange)
+				if (ComputeSegmentDeformationError(SegmentStart, Candidate, MeshRadius, true, Scratch) <= Layer.DeformationTolerance)
 				{
-					const FSplinedMeshRange& CurrentRange = CurrentRepetitionInfo.Ranges[nRange];
-					FPositionRange Range;
-					Range.Start = FMath::Max(CurrentRange.RangeStart, 0.0f);
-					Range.End = FMath::Min(Spline->Duration, CurrentRange.RangeEnd);
-					PositionRanges.Add(Range);
+					GoodEnd = Candidate;
+					if (Candidate >= ChunkEnd)
+					{
+						break;
+					}
+					Candidate = FMath::Min(SegmentStart + (Candidate - SegmentStart) * 2.0f, ChunkEnd);
 				}
-				break;
-			}
-			case ERepetitionType::BetweenPoints:
-			{
-				const int32 nRanges = CurrentRepetitionInfo.Ranges.Num();
-				for (int32 nRange = 0; nRange < nRanges; ++nRange)
+				else
 				{
-					const FSplinedMeshRange& CurrentRange = CurrentRepetitionInfo.Ranges[nRange];
-					FPositionRange Range;
-					Range.Start = ConvertPointToTime(FMath::Max(CurrentRange.RangeStart, 0));
-					Range.End = ConvertPointToTime(FMath::Min(Spline->GetNumberOfSplinePoints() - 1, CurrentRange.RangeEnd));
-					PositionRanges.Add(Range);
+					BadEnd = Candidate;
+					break;
 				}
-				break;
 			}
-		}
 
-		const float Repetition = FMath::Max(CurrentRepetitionInfo.Repetition, 0.009f);
-		for (const FPositionRange& Range : PositionRanges)
-		{
-			for (float CurrentPosition = Range.Start; CurrentPosition < Range.End; CurrentPosition += Repetition)
+			if (BadEnd > GoodEnd)
 			{
-				const int32 Index = FMath::FloorToInt((CurrentPosition - Range.Start) / Repetition);
-				const int32 MaxIndex = FMath::FloorToInt((Range.End - Range.Start) / Repetition);
-				UStaticMeshComponent* NewComponent = CreateMeshAtPosition(CurrentPosition, CurrentMeshInfo);
+				// A known good end is refined to a fraction of a key, without one the search halves down to float precision
+				while (GoodEnd <= SegmentStart || BadEnd - GoodEnd > DeformationSearchResolution)
+				{
+					const float MidKey = (GoodEnd + BadEnd) * 0.5f;
+					if (MidKey <= GoodEnd || MidKey >= BadEnd)
+					{
+						break;
+					}
 
-				if (CurrentAdditionalMesh.bTriggerCreationEvent)
+					if (ComputeSegmentDeformationError(SegmentStart, MidKey, MeshRadius, true, Scratch) <= Layer.DeformationTolerance)
+					{
+						GoodEnd = MidKey;
+					}
+					else
+					{
+						BadEnd = MidKey;
+					}
+				}
+
+				// Only the smallest segment float can represent is accepted above the tolerance
+				if (GoodEnd <= SegmentStart)
 				{
-					OnAdditionalMeshCreated(Index, MaxIndex, CurrentAdditionalMesh.Identifier, NewComponent);
+					GoodEnd = BadEnd;
 				}
 			}
+
+			// Never below the resolution, a step lost to float rounding would stop the growth
+			Step = FMath::Max(GoodEnd - SegmentStart, DeformationSearchResolution);
+			SegmentStart = GoodEnd;
+			SegmentKeys.Add(SegmentStart);
 		}
 	}
 }
 
-UStaticMeshComponent* AMultiMeshSpline::CreateMeshAtPosition(float Position, const FAdditionalMeshInfo& MeshInfo)
+float AMultiMeshSpline::ComputeSegmentDeformationError(float StartKey, float EndKey, float MeshRadius, bool bScaleTangents, FSplineBatchSamples& Scratch) const
 {
-	const FVector Location = Spline->GetLocationAtTime(Position, ESplineCoordinateSpace::Local);
-	const FVector Tangent = Spline->GetTangentAtTime(Position, ESplineCoordinateSpace::Local);
+	// Both ends and every error sample come from one batch
+	TArray<float, TInlineAllocator<DeformationErrorSamples + 1>> Keys;
+	for (int32 nSample = 0; nSample <= DeformationErrorSamples; ++nSample)
+	{
+		Keys.Add(FMath::Lerp(StartKey, EndKey, static_cast<float>(nSample) / DeformationErrorSamples));
+	}
+	Keys[0] = StartKey;
+	Keys[DeformationErrorSamples] = EndKey;
 
-	UStaticMeshComponent* Component = Cast<UStaticMeshComponent>(AddComponentByClass(MeshInfo.MeshClass, false, Spline->GetComponentTransform(), false));
-	if(!IsValid(Component))
+	// Called many times per segment while searching, the caller's scratch batch keeps this free of allocations
+	FSplineBatchEvaluator::EvaluateAtInputKeys(Spline, Keys, Scratch);
+
+	const FSplineMeshParams Params = MakeSegmentParams(StartKey, MakeSplineSample(Scratch, 0), EndKey, MakeSplineSample(Scratch, DeformationErrorSamples), bScaleTangents);
+	float MaxError = 0.0f;
+
+	for (int32 nSample = 1; nSample < DeformationErrorSamples; ++nSample)
 	{
-		return nullptr;
+		// USplineMeshComponent evaluates a hermite curve for position and lerps roll and scale
+		const float Alpha = static_cast<float>(nSample) / DeformationErrorSamples;
+		const FSplineSample Sample = MakeSplineSample(Scratch, nSample);
+
+		const FVector DeformedLocation = FMath::CubicInterp(Params.StartPos, Params.StartTangent, Params.EndPos, Params.EndTangent, Alpha);
+		MaxError = FMath::Max(MaxError, FVector::Dist(DeformedLocation, Sample.Location));
+
+		if (MeshRadius > 0.0f)
+		{
+			const float DeformedRoll = FMath::Lerp(Params.StartRoll, Params.EndRoll, Alpha);
+			const float SplineRoll = FMath::DegreesToRadians(Sample.Roll);
+			MaxError = FMath::Max(MaxError, FMath::Abs(FMath::FindDeltaAngleRadians(DeformedRoll, SplineRoll)) * MeshRadius);
+
+			const FVector2D DeformedScale = FMath::Lerp(Params.StartScale, Params.EndScale, Alpha);
+			const FVector& SplineScale = Sample.Scale;
+			const float ScaleError = FMath::Max(FMath::Abs(DeformedScale.X - SplineScale.Y), FMath::Abs(DeformedScale.Y - SplineScale.Z));
+			MaxError = FMath::Max(MaxError, ScaleError * MeshRadius);
+		}
 	}
 
-	CreatedAdditionalMeshes.Add(Component);
+	return MaxError;
+}
 
-	Component->SetStaticMesh(MeshInfo.Mesh);
-	Component->SetRelativeLocation(Location + MeshInfo.LocationOffset);
-	Component->SetRelativeScale3D(MeshInfo.Scale);
+float AMultiMeshSpline::GetLayerCrossSectionRadius(const FSplineMeshLayer& Layer)
+{
+	if (!IsValid(Layer.Mesh))
+	{
+		return 0.0f;
+	}
+
+	const FBoxSphereBounds Bounds = Layer.Mesh->GetBounds();
+	const FVector2D MeshRadius(FMath::Abs(Bounds.Origin.Y) + Bounds.BoxExtent.Y, FMath::Abs(Bounds.Origin.Z) + Bounds.BoxExtent.Z);
+	return MeshRadius.Size() + Layer.Offset.Size();
+}
+
+void AMultiMeshSpline::SegmentLayers(const TArray<FSplineMeshLayer>& Layers, float KeysPerTime, float StartKey, float EndKey, FLayerSegmentation& OutSegmentation) const
+{
+	// Every layer picks its own segment keys, the spline is then sampled once for the union of them
+	OutSegmentation.LayerKeys.Reset();
+	OutSegmentation.LayerKeys.SetNum(Layers.Num());
+	OutSegmentation.SampleKeys.Reset();
 
-	if (MeshInfo.bAdjustByBounds)
+	for (int32 nLayer = 0; nLayer < Layers.Num(); ++nLayer)
 	{
-		FVector BoundsMin;
-		FVector BoundsMax;
-		Component->GetLocalBounds(BoundsMin, BoundsMax);
-		const FVector BoundsCenter = ((BoundsMin + BoundsMax) / 2.0f) * MeshInfo.Scale;
-		Component->AddRelativeLocation(-BoundsCenter);
+		if (nLayer > 0 && !IsValid(Layers[nLayer].Mesh))
+		{
+			continue;
+		}
+		GatherSegmentKeys(Layers[nLayer], KeysPerTime, StartKey, EndKey, OutSegmentation.LayerKeys[nLayer]);
+		OutSegmentation.SampleKeys.Append(OutSegmentation.LayerKeys[nLayer]);
 	}
 
-	Component->SetRelativeRotation(FRotationMatrix::MakeFromX(Tangent).Rotator() + MeshInfo.RotationOffset);
-	Component->AttachToComponent(Spline, FAttachmentTransformRules::KeepRelativeTransform);
-	return Component;
+	OutSegmentation.SampleKeys.Sort();
+	OutSegmentation.SampleKeys.SetNum(Algo::Unique(OutSegmentation.SampleKeys));
+
+	FSplineBatchSamples BatchSamples;
+	FSplineBatchEvaluator::EvaluateAtInputKeys(Spline, OutSegmentation.SampleKeys, BatchSamples);
+
+	OutSegmentation.Samples.SetNumUninitialized(BatchSamples.Num());
+	for (int32 nSample = 0; nSample < BatchSamples.Num(); ++nSample)
+	{
+		OutSegmentation.Samples[nSample] = MakeSplineSample(BatchSamples, nSample);
+	}
+}
+
+FSplineMeshParams AMultiMeshSpline::MakeLayerSegmentParams(const FSplineMeshLayer& Layer, const FLayerSegmentation& Segmentation, float StartKey, float EndKey)
+{
+	const int32 StartSample = Algo::BinarySearch(Segmentation.SampleKeys, StartKey);
+	const int32 EndSample = Algo::BinarySearch(Segmentation.SampleKeys, EndKey);
 
+	FSplineMeshParams Params = MakeSegmentParams(StartKey, Segmentation.Samples[StartSample], EndKey, Segmentation.Samples[EndSample], Layer.SplineType == Deformation);
+	Params.StartOffset = Layer.Offset;
+	Params.EndOffset = Layer.Offset;
+	return Params;
 }
 
-FORCEINLINE float AMultiMeshSpline::ConvertPointToTime(const int32 Point) const
+FSplineSample AMultiMeshSpline::MakeSplineSample(const FSplineBatchSamples& BatchSamples, int32 Index)
 {
-	return Spline->GetDistanceAlongSplineAtSplinePoint(Point) / Spline->GetSplineLength() * Spline->Duration;
+	FSplineSample Sample;
+	Sample.Location = BatchSamples.Locations[Index];
+	Sample.Tangent = BatchSamples.Tangents[Index];
+	Sample.Scale = BatchSamples.Scales[Index];
+	Sample.Roll = BatchSamples.Rolls[Index];
+	return Sample;
 }
 
-void AMultiMeshSpline::OnConstruction(const FTransform& Transform)
+FSplineMeshParams AMultiMeshSpline::MakeSegmentParams(float StartKey, const FSplineSample& Start, float EndKey, const FSplineSample& End, bool bScaleTangents)
 {
-	Super::OnConstruction(Transform);
-	Refresh();
+	// Spline tangents are per input key, a segment spanning a different key range needs them rescaled to its own length
+	const float TangentScale = bScaleTangents ? EndKey - StartKey : 1.0f;
+
+	FSplineMeshParams Params;
+	Params.StartPos = Start.Location;
+	Params.EndPos = End.Location;
+	Params.StartTangent = Start.Tangent * TangentScale;
+	Params.EndTangent = End.Tangent * TangentScale;
+	Params.StartScale = FVector2D{ Start.Scale.Y, Start.Scale.Z };
+	Params.EndScale = FVector2D{ End.Scale.Y, End.Scale.Z };
+	Params.StartRoll = FMath::DegreesToRadians(Start.Roll);
+	Params.EndRoll = FMath::DegreesToRadians(End.Roll);
+	return Params;
 }
 
-void AMultiMeshSpline::UpdateCollisionInfo()
+FSplineMeshLayer AMultiMeshSpline::MakePrimaryLayer() const
 {
-	for (USplineMeshComponent* CreatedMesh : CreatedMeshes)
+	FSplineMeshLayer Layer;
+	Layer.Mesh = Mesh;
+	Layer.SplineType = SplineType;
+	Layer.TimeInterval = TimeInterval;
+	Layer.MaxSteepnessThreshold = MaxSteepnessThreshold;
+	Layer.DeformationTolerance = DeformationTolerance;
+	Layer.bInstanced = bInstanced;
+	return Layer;
+}
+
+const FBodyInstance& AMultiMeshSpline::GetLayerBodyInstance(int32 LayerIndex) const
+{
+	// Layer 0 is the primary mesh, the others map to MeshLayers
+	const int32 MeshLayerIndex = LayerIndex - 1;
+	if (MeshLayers.IsValidIndex(MeshLayerIndex) && MeshLayers[MeshLayerIndex].bOverrideCollision)
 	{
-		if (CreatedMesh)
+		return MeshLayers[MeshLayerIndex].BodyInstance;
+	}
+	return BodyInstance;
+}
+
+USplineMeshComponent* AMultiMeshSpline::AddSplineMeshComponent(int32 LayerIndex, EComponentMobility::Type Mobility)
+{
+	USplineMeshComponent* Component = Cast<USplineMeshComponent>(AddComponentByClass(USplineMeshComponent::StaticClass(), true, GetActorTransform(), false));
+
+	if(!IsValid(Component))
+	{
+		return nullptr;
+	}
+
+	CreatedMeshes.Add(Component);
+	CreatedMeshLayers.Add(LayerIndex);
+	Component->SetMobility(Mobility);
+	Component->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepWorldTransform);
+	return Component;
+}
+
+void AMultiMeshSpline::ApplySplineMeshLayer(USplineMeshComponent* Component, const FSplineMeshLayer& Layer, int32 LayerIndex, const FSplineMeshParams& Params)
+{
+	Component->SetStaticMesh(Layer.Mesh);
+	Component->SetStartAndEnd(Params.StartPos, Params.StartTangent, Params.EndPos, Params.EndTangent);
+	Component->SetStartRoll(Params.StartRoll);
+	Component->SetEndRoll(Params.EndRoll);
+	Component->SetStartScale(Params.StartScale);
+	Component->SetEndScale(Params.EndScale);
+	Component->SetStartOffset(Layer.Offset);
+	Component->SetEndOffset(Layer.Offset);
+	Component->BodyInstance.CopyRuntimeBodyInstancePropertiesFrom(&GetLayerBodyInstance(LayerIndex));
+}
+
+void AMultiMeshSpline::UpdateInstancedLayers(const TArray<FSplineMeshLayer>& Layers, const TArray<TArray<FSplineMeshParams>>& InstancedSegments)
+{
+	for (int32 nLayer = 0; nLayer < CreatedInstancedLayers.Num(); ++nLayer)
+	{
+		UInstancedStaticMeshComponent* Component = CreatedInstancedLayers[nLayer];
+		if (IsValid(Component) && (!InstancedSegments.IsValidIndex(nLayer) || InstancedSegments[nLayer].IsEmpty()))
+		{
+			AddDirtyBounds(Component);
+			Component->DestroyComponent();
+			CreatedInstancedLayers[nLayer] = nullptr;
+		}
+	}
+	CreatedInstancedLayers.SetNum(Layers.Num());
+
+	for (int32 nLayer = 0; nLayer < Layers.Num(); ++nLayer)
+	{
+		if (!InstancedSegments[nLayer].IsEmpty())
 		{
-			CreatedMesh->BodyInstance.CopyRuntimeBodyInstancePropertiesFrom(&this->BodyInstance);
+			UpdateInstancedLayer(nLayer, Layers[nLayer], InstancedSegments[nLayer]);
 		}
 	}
 }
 
-void AMultiMeshSpline::Refresh()
+void AMultiMeshSpline::UpdateInstancedLayer(int32 LayerIndex, const FSplineMeshLayer& Layer, TConstArrayView<FSplineMeshParams> Segments)
 {
-	for (USplineMeshComponent* CreatedMesh : CreatedMeshes)
+	FSplineMeshInstancePacker::FPackedSegments Packed;
+	FSplineMeshInstancePacker::PackSegments(Segments, Layer.Mesh->GetBoundingBox(), Packed);
+
+	UInstancedStaticMeshComponent*& Component = CreatedInstancedLayers[LayerIndex];
+	if (IsValid(Component))
 	{
-		if (CreatedMesh)
+		// Instance transforms are stored in float, the custom data is compared exactly
+		bool bUpToDate = Component->GetStaticMesh() == Layer.Mesh && Component->GetInstanceCount() == Packed.Transforms.Num()
+			&& Component->PerInstanceSMCustomData == Packed.CustomData;
+		for (int32 nInstance = 0; bUpToDate && nInstance < Packed.Transforms.Num(); ++nInstance)
 		{
-			CreatedMesh->DestroyComponent();
+			FTransform InstanceTransform;
+			Component->GetInstanceTransform(nInstance, InstanceTransform, false);
+			bUpToDate = InstanceTransform.GetTranslation().Equals(Packed.Transforms[nInstance].GetTranslation(), 0.01f);
+		}
+
+		if (bUpToDate)
+		{
+			return;
 		}
+		AddDirtyBounds(Component);
 	}
-	for (UStaticMeshComponent* CreatedMesh : CreatedAdditionalMeshes)
+	else
 	{
-		if (CreatedMesh)
+		Component = Cast<UInstancedStaticMeshComponent>(AddComponentByClass(UInstancedStaticMeshComponent::StaticClass(), true, GetActorTransform(), false));
+		if (!IsValid(Component))
 		{
-			CreatedMesh->DestroyComponent();
+			return;
 		}
+
+		Component->SetMobility(EComponentMobility::Static);
+		Component->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepWorldTransform);
+
+		// Collision and navigation would see the undeformed mesh in the middle of every segment
+		Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		Component->SetCanEverAffectNavigation(false);
 	}
-	CreatedAdditionalMeshes.Empty();
-	CreatedMeshes.Empty();
 
-	switch (SplineType)
+	Component->SetStaticMesh(Layer.Mesh);
+	Component->ClearInstances();
+	Component->SetNumCustomDataFloats(FSplineMeshInstancePacker::NumCustomDataFloats);
+	Component->AddInstances(Packed.Transforms, false);
+
+	for (int32 nInstance = 0; nInstance < Packed.Transforms.Num(); ++nInstance)
 	{
-		case Point: GenerateMeshesByPoints(); break;
-		case TimeBased: GenerateMeshesByTime(); break;
-		case Steepness: GenerateMeshesBySteepness(); break;
+		const TArrayView<const float> CustomData(Packed.CustomData.GetData() + nInstance * FSplineMeshInstancePacker::NumCustomDataFloats, FSplineMeshInstancePacker::NumCustomDataFloats);
+		Component->SetCustomData(nInstance, CustomData, false);
+	}
+
+	// Only grows the component bounds, the GPU scene culls each instance with its undeformed bounds padded by the material's Max World Position Offset Displacement
+	Component->SetBoundsScale(Packed.BoundsScale);
+	Component->MarkRenderStateDirty();
+	Component->UpdateBounds();
+	AddDirtyBounds(Component);
+}
+
+void AMultiMeshSpline::GatherMeshLayers(TArray<FSplineMeshLayer>& Layers) const
+{
+	Layers.Add(MakePrimaryLayer());
+	for (const FSplineMeshLayer& Layer : MeshLayers)
+	{
+		Layers.Add(Layer);
+	}
+}
+
+void AMultiMeshSpline::GenerateSplineMeshes()
+{
+	TArray<FSplineMeshLayer> Layers;
+	GatherMeshLayers(Layers);
+
+	FLayerSegmentation Segmentation;
+	SegmentLayers(Layers, GetKeysPerTime(), 0.0f, Spline->GetNumberOfSplineSegments(), Segmentation);
+
+	struct FSegmentEntry
+	{
+		int32 LayerIndex;
+		float StartKey;
+		float EndKey;
+		FSplineMeshParams Params;
+	};
+
+	TArray<FSegmentEntry> Entries;
+	TArray<TArray<FSplineMeshParams>> InstancedSegments;
+	InstancedSegments.SetNum(Layers.Num());
+
+	for (int32 nLayer = 0; nLayer < Layers.Num(); ++nLayer)
+	{
+		const FSplineMeshLayer& Layer = Layers[nLayer];
+		const bool bInstancedLayer = Layer.bInstanced && IsValid(Layer.Mesh);
+		const TArray<float>& SegmentKeys = Segmentation.LayerKeys[nLayer];
+
+		for (int32 i = 0; i < SegmentKeys.Num() - 1; i++)
+		{
+			const FSplineMeshParams Params = MakeLayerSegmentParams(Layer, Segmentation, SegmentKeys[i], SegmentKeys[i + 1]);
+
+			if (bInstancedLayer)
+			{
+				if (nLayer == 0)
+				{
+					RegisterSpatialSegment(MakeInstancedSegmentId(InstancedSegments[nLayer].Num()), SegmentKeys[i], SegmentKeys[i + 1]);
+				}
+				InstancedSegments[nLayer].Add(Params);
+				continue;
+			}
+
+			FSegmentEntry& Entry = Entries.AddDefaulted_GetRef();
+			Entry.LayerIndex = nLayer;
+			Entry.StartKey = SegmentKeys[i];
+			Entry.EndKey = SegmentKeys[i + 1];
+			Entry.Params = Params;
+		}
+	}
+
+	UpdateInstancedLayers(Layers, InstancedSegments);
+
+	// Components whose segment didn't change are kept as they are, so they never dirty navigation or rendering
+	TArray<USplineMeshComponent*> OldMeshes = MoveTemp(CreatedMeshes);
+	TArray<int32> OldMeshLayers = MoveTemp(CreatedMeshLayers);
+	CreatedMeshes.Reset();
+	CreatedMeshLayers.Reset();
+
+	TMultiMap<uint32, int32> OldMeshesByHash;
+	for (int32 nOld = 0; nOld < OldMeshes.Num(); ++nOld)
+	{
+		USplineMeshComponent* OldMesh = OldMeshes[nOld];
+		if (!IsValid(OldMesh))
+		{
+			continue;
+		}
+
+		// Hidden segments were pooled by a streamed copy of this actor and have no collision, they are never kept or reused
+		if (!OldMesh->IsVisible() || !OldMeshLayers.IsValidIndex(nOld))
+		{
+			AddDirtyBounds(OldMesh);
+			OldMesh->DestroyComponent();
+			continue;
+		}
+		OldMeshesByHash.Add(HashSplineMeshSegment(OldMeshLayers[nOld], OldMesh->GetStaticMesh(), OldMesh->SplineParams), nOld);
+	}
+
+	TArray<USplineMeshComponent*> Matches;
+	Matches.Init(nullptr, Entries.Num());
+	for (int32 nEntry = 0; nEntry < Entries.Num(); ++nEntry)
+	{
+		const FSegmentEntry& Entry = Entries[nEntry];
+		const UStaticMesh* LayerMesh = Layers[Entry.LayerIndex].Mesh;
+
+		for (TMultiMap<uint32, int32>::TKeyIterator It = OldMeshesByHash.CreateKeyIterator(HashSplineMeshSegment(Entry.LayerIndex, LayerMesh, Entry.Params)); It; ++It)
+		{
+			USplineMeshComponent* OldMesh = OldMeshes[It.Value()];
+			if (OldMeshLayers[It.Value()] == Entry.LayerIndex && OldMesh->GetStaticMesh() == LayerMesh && AreSplineMeshParamsEqual(OldMesh->SplineParams, Entry.Params))
+			{
+				Matches[nEntry] = OldMesh;
+				It.RemoveCurrent();
+				break;
+			}
+		}
+	}
+
+	// Leftovers are reshaped in place before new components are added
+	TArray<TArray<USplineMeshComponent*>> FreeMeshesByLayer;
+	FreeMeshesByLayer.SetNum(Layers.Num());
+	for (const TPair<uint32, int32>& Pair : OldMeshesByHash)
+	{
+		const int32 LayerIndex = OldMeshLayers[Pair.Value];
+		if (FreeMeshesByLayer.IsValidIndex(LayerIndex))
+		{
+			FreeMeshesByLayer[LayerIndex].Add(OldMeshes[Pair.Value]);
+		}
+		else
+		{
+			AddDirtyBounds(OldMeshes[Pair.Value]);
+			OldMeshes[Pair.Value]->DestroyComponent();
+		}
+	}
+
+	for (int32 nEntry = 0; nEntry < Entries.Num(); ++nEntry)
+	{
+		const FSegmentEntry& Entry = Entries[nEntry];
+		USplineMeshComponent* Component = Matches[nEntry];
+
+		if (Component)
+		{
+			CreatedMeshes.Add(Component);
+			CreatedMeshLayers.Add(Entry.LayerIndex);
+		}
+		else
+		{
+			TArray<USplineMeshComponent*>& FreeMeshes = FreeMeshesByLayer[Entry.LayerIndex];
+			const bool bReused = FreeMeshes.Num() > 0;
+			if (bReused)
+			{
+				Component = FreeMeshes.Pop();
+				AddDirtyBounds(Component);
+				CreatedMeshes.Add(Component);
+				CreatedMeshLayers.Add(Entry.LayerIndex);
+			}
+			else
+			{
+				Component = AddSplineMeshComponent(Entry.LayerIndex, EComponentMobility::Static);
+				if (!Component)
+				{
+					continue;
+				}
+			}
+
+			ApplySplineMeshLayer(Component, Layers[Entry.LayerIndex], Entry.LayerIndex, Entry.Params);
+			Component->UpdateBounds();
+			AddDirtyBounds(Component);
+
+			// Reshaping doesn't move the component, navigation only hears about it when told
+			if (bReused)
+			{
+				FNavigationSystem::UpdateComponentData(*Component);
+			}
+		}
+
+		if (Entry.LayerIndex == 0)
+		{
+			RegisterSpatialSegment(CreatedMeshes.Num() - 1, Entry.StartKey, Entry.EndKey);
+		}
+	}
+
+	for (const TArray<USplineMeshComponent*>& FreeMeshes : FreeMeshesByLayer)
+	{
+		for (USplineMeshComponent* FreeMesh : FreeMeshes)
+		{
+			AddDirtyBounds(FreeMesh);
+			FreeMesh->DestroyComponent();
+		}
+	}
+}
+
+void AMultiMeshSpline::CompareSegmentationModes()
+{
+	const ESplineMeshType Types[] = { Point, TimeBased, Steepness, Deformation };
+	FSplineMeshLayer Layer = MakePrimaryLayer();
+	const float MeshRadius = GetLayerCrossSectionRadius(Layer);
+	FSplineBatchSamples Scratch;
+
+	for (const ESplineMeshType Type : Types)
+	{
+		Layer.SplineType = Type;
+
+		const double StartSeconds = FPlatformTime::Seconds();
+		TArray<float> SegmentKeys;
+		GatherSegmentKeys(Layer, GetKeysPerTime(), 0.0f, Spline->GetNumberOfSplineSegments(), SegmentKeys);
+		const double ElapsedMs = (FPlatformTime::Seconds() - StartSeconds) * 1000.0;
+
+		float MaxError = 0.0f;
+		for (int32 i = 0; i < SegmentKeys.Num() - 1; i++)
+		{
+			MaxError = FMath::Max(MaxError, ComputeSegmentDeformationError(SegmentKeys[i], SegmentKeys[i + 1], MeshRadius, Type == Deformation, Scratch));
+		}
+
+		UE_LOG(LogSplineHelper, Display, TEXT("%s: %s -> %d segments, max deformation error %.3f, %.2f ms"),
+			*GetName(), *UEnum::GetValueAsString(Type), FMath::Max(SegmentKeys.Num() - 1, 0), MaxError, ElapsedMs);
+	}
+}
+
+void AMultiMeshSpline::BenchmarkSplineEvaluation()
+{
+	constexpr int32 NumSamples = 100000;
+	constexpr int32 NumRuns = 5;
+
+	TArray<float> Times;
+	Times.Reserve(NumSamples);
+	for (int32 nSample = 0; nSample < NumSamples; ++nSample)
+	{
+		Times.Add(Spline->Duration * nSample / (NumSamples - 1));
+	}
+
+	// Best of several runs, the first one also pays for page faults of the output arrays
+	FSplineBatchSamples ScalarSamples;
+	FSplineBatchSamples BatchSamples;
+	double ScalarSeconds = TNumericLimits<double>::Max();
+	double BatchSeconds = TNumericLimits<double>::Max();
+
+	for (int32 nRun = 0; nRun < NumRuns; ++nRun)
+	{
+		double StartSeconds = FPlatformTime::Seconds();
+		FSplineBatchEvaluator::EvaluateAtTimesScalar(Spline, Times, ScalarSamples);
+		ScalarSeconds = FMath::Min(ScalarSeconds, FPlatformTime::Seconds() - StartSeconds);
+
+		StartSeconds = FPlatformTime::Seconds();
+		FSplineBatchEvaluator::EvaluateAtTimes(Spline, Times, BatchSamples);
+		BatchSeconds = FMath::Min(BatchSeconds, FPlatformTime::Seconds() - StartSeconds);
+	}
+
+	double MaxLocationError = 0.0;
+	double MaxTangentError = 0.0;
+	float MaxRollError = 0.0f;
+	for (int32 nSample = 0; nSample < NumSamples; ++nSample)
+	{
+		MaxLocationError = FMath::Max(MaxLocationError, FVector::Dist(ScalarSamples.Locations[nSample], BatchSamples.Locations[nSample]));
+		MaxTangentError = FMath::Max(MaxTangentError, FVector::Dist(ScalarSamples.Tangents[nSample], BatchSamples.Tangents[nSample]));
+		MaxRollError = FMath::Max(MaxRollError, FMath::Abs(FMath::FindDeltaAngleDegrees(ScalarSamples.Rolls[nSample], BatchSamples.Rolls[nSample])));
+	}
+
+	UE_LOG(LogSplineHelper, Display, TEXT("%s: %d samples, scalar %.2f ms, batch %.2f ms (%.1fx), max error location %g, tangent %g, roll %g"),
+		*GetName(), NumSamples, ScalarSeconds * 1000.0, BatchSeconds * 1000.0, ScalarSeconds / FMath::Max(BatchSeconds, UE_SMALL_NUMBER),
+		MaxLocationError, MaxTangentError, MaxRollError);
+}
+
+void AMultiMeshSpline::LogInstancingStats()
+{
+	TArray<FSplineMeshLayer> Layers;
+	GatherMeshLayers(Layers);
+
+	TArray<int32> NumSegments;
+	NumSegments.Init(0, Layers.Num());
+	for (const int32 LayerIndex : CreatedMeshLayers)
+	{
+		if (NumSegments.IsValidIndex(LayerIndex))
+		{
+			++NumSegments[LayerIndex];
+		}
+	}
+	for (int32 nLayer = 0; nLayer < CreatedInstancedLayers.Num() && nLayer < Layers.Num(); ++nLayer)
+	{
+		if (IsValid(CreatedInstancedLayers[nLayer]))
+		{
+			NumSegments[nLayer] += CreatedInstancedLayers[nLayer]->GetInstanceCount();
+		}
+	}
+
+	for (int32 nLayer = 0; nLayer < Layers.Num(); ++nLayer)
+	{
+		if (!IsValid(Layers[nLayer].Mesh))
+		{
+			continue;
+		}
+
+		const FSplineMeshInstancePacker::FStats Stats = FSplineMeshInstancePacker::ComputeStats(NumSegments[nLayer], Layers[nLayer].Mesh->GetNumSections(0));
+		UE_LOG(LogSplineHelper, Display, TEXT("%s: layer %d (%s%s), %d segments, draws %d as components / %d instanced, memory at least %.1f KB / %.1f KB"),
+			*GetName(), nLayer, *Layers[nLayer].Mesh->GetName(), Layers[nLayer].bInstanced ? TEXT(", instanced") : TEXT(""), Stats.NumSegments,
+			Stats.ComponentDrawCalls, Stats.InstancedDrawCalls, Stats.ComponentBytes / 1024.0, Stats.InstancedBytes / 1024.0);
+	}
+}
+
+struct FPositionRange
+{
+	float Start;
+	float End;
+};
+
+void AMultiMeshSpline::GenerateAdditionalMeshes()
+{
+	struct FPropEntry
+	{
+		int32 SettingsIndex;
+		int32 Index;
+		int32 MaxIndex;
+	};
+
+	TArray<FAdditionalMeshPlacement> Placements;
+	GatherAdditionalMeshPlacements(Placements);
+
+	// Every prop transform is computed into one array before any component is touched, Transforms[N] belongs to Entries[N]
+	TArray<FPropEntry> Entries;
+	TArray<FTransform> Transforms;
+	TArray<float> Times;
+	TArray<FVector> Locations;
+	TArray<FVector> Tangents;
+	const int32 AdditionalMeshesNum = AdditionalMeshSettings.Num();
+	for (int32 nAdditionalMesh = 0; nAdditionalMesh < AdditionalMeshesNum; ++nAdditionalMesh)
+	{
+		const FAdditionalMesh& CurrentAdditionalMesh = AdditionalMeshSettings[nAdditionalMesh];
+		const FAdditionalMeshInfo& CurrentMeshInfo = CurrentAdditionalMesh.InstanceInfo;
+		const FAdditionalMeshRepetitionParams& CurrentRepetitionInfo = CurrentAdditionalMesh.RepetitionInfo;
+
+		if(FMath::IsNearlyZero(CurrentRepetitionInfo.Repetition) || !IsValid(CurrentMeshInfo.Mesh) || !IsValid(CurrentMeshInfo.MeshClass))
+		{
+			continue;
+		}
+
+		TArray<FPositionRange> PositionRanges;
+		switch (CurrentRepetitionInfo.Type)
+		{
+			case ERepetitionType::Always:
+			{
+				FPositionRange Range;
+				Range.Start = 0.0f;
+				Range.End = Spline->Duration;
+				PositionRanges.Add(Range);
+				break;
+			}
+			case ERepetitionType::BetweenTimeIntervals:
+			{
+				const int32 nRanges = CurrentRepetitionInfo.Ranges.Num();
+				for (int32 nRange = 0; nRange < nRanges; ++nRange)
+				{
+					const FSplinedMeshRange& CurrentRange = CurrentRepetitionInfo.Ranges[nRange];
+					FPositionRange Range;
+					Range.Start = FMath::Max(CurrentRange.RangeStart, 0.0f);
+					Range.End = FMath::Min(Spline->Duration, CurrentRange.RangeEnd);
+					PositionRanges.Add(Range);
+				}
+				break;
+			}
+			case ERepetitionType::BetweenPoints:
+			{
+				const int32 nRanges = CurrentRepetitionInfo.Ranges.Num();
+				for (int32 nRange = 0; nRange < nRanges; ++nRange)
+				{
+					const FSplinedMeshRange& CurrentRange = CurrentRepetitionInfo.Ranges[nRange];
+					FPositionRange Range;
+					Range.Start = ConvertInputKeyToTime(FMath::Max(CurrentRange.RangeStart, 0));
+					Range.End = ConvertInputKeyToTime(FMath::Min(Spline->GetNumberOfSplinePoints() - 1, CurrentRange.RangeEnd));
+					PositionRanges.Add(Range);
+				}
+				break;
+			}
+		}
+
+		const float Repetition = FMath::Max(CurrentRepetitionInfo.Repetition, 0.009f);
+		for (const FPositionRange& Range : PositionRanges)
+		{
+			Times.Reset();
+			for (float CurrentPosition = Range.Start; CurrentPosition < Range.End; CurrentPosition += Repetition)
+			{
+				Times.Add(CurrentPosition);
+			}
+			FSplineBatchEvaluator::EvaluatePositionsAtTimes(Spline, Times, Locations, Tangents);
+
+			const FAdditionalMeshPlacement& Placement = Placements[nAdditionalMesh];
+			Entries.Reserve(Entries.Num() + Times.Num());
+			Transforms.Reserve(Transforms.Num() + Times.Num());
+
+			for (int32 nTime = 0; nTime < Times.Num(); ++nTime)
+			{
+				FPropEntry& Entry = Entries.AddDefaulted_GetRef();
+				Entry.SettingsIndex = nAdditionalMesh;
+				Entry.Index = FMath::FloorToInt((Times[nTime] - Range.Start) / Repetition);
+				Entry.MaxIndex = FMath::FloorToInt((Range.End - Range.Start) / Repetition);
+				Transforms.Add(ComputeAdditionalMeshTransform(Locations[nTime], Tangents[nTime], Placement));
+			}
+		}
+	}
+
+	// Same diff as the segments, props that kept their class, mesh and transform are not touched
+	TArray<UStaticMeshComponent*> OldMeshes = MoveTemp(CreatedAdditionalMeshes);
+	TArray<FIntPoint> OldIndices = MoveTemp(CreatedAdditionalMeshIndices);
+	CreatedAdditionalMeshes.Reset();
+	CreatedAdditionalMeshIndices.Reset();
+
+	// Values are indices into OldMeshes
+	TMultiMap<uint32, int32> OldMeshesByHash;
+	for (int32 nOld = 0; nOld < OldMeshes.Num(); ++nOld)
+	{
+		UStaticMeshComponent* OldMesh = OldMeshes[nOld];
+		if (!IsValid(OldMesh))
+		{
+			continue;
+		}
+
+		// Same as the segments, pooled streaming props are hidden and without collision
+		if (!OldMesh->IsVisible())
+		{
+			AddDirtyBounds(OldMesh);
+			OldMesh->DestroyComponent();
+			continue;
+		}
+		OldMeshesByHash.Add(HashAdditionalMesh(OldMesh->GetClass(), OldMesh->GetStaticMesh(), OldMesh->GetRelativeLocation()), nOld);
+	}
+
+	TArray<UStaticMeshComponent*> Matches;
+	Matches.Init(nullptr, Entries.Num());
+	for (int32 nEntry = 0; nEntry < Entries.Num(); ++nEntry)
+	{
+		const FPropEntry& Entry = Entries[nEntry];
+		const FAdditionalMesh& Settings = AdditionalMeshSettings[Entry.SettingsIndex];
+		const FAdditionalMeshInfo& MeshInfo = Settings.InstanceInfo;
+
+		// The events report Index and MaxIndex, a kept component that moved to another index would never hear about it
+		const bool bMatchIndices = WantsCreationResults(Settings);
+		const FIntPoint EntryIndices(Entry.Index, Entry.MaxIndex);
+
+		for (TMultiMap<uint32, int32>::TKeyIterator It = OldMeshesByHash.CreateKeyIterator(HashAdditionalMesh(MeshInfo.MeshClass, MeshInfo.Mesh, Transforms[nEntry].GetLocation())); It; ++It)
+		{
+			UStaticMeshComponent* OldMesh = OldMeshes[It.Value()];
+			if (bMatchIndices && (!OldIndices.IsValidIndex(It.Value()) || OldIndices[It.Value()] != EntryIndices))
+			{
+				continue;
+			}
+
+			if (OldMesh->GetClass() == MeshInfo.MeshClass && OldMesh->GetStaticMesh() == MeshInfo.Mesh && OldMesh->GetRelativeTransform().Equals(Transforms[nEntry]))
+			{
+				Matches[nEntry] = OldMesh;
+				It.RemoveCurrent();
+				break;
+			}
+		}
+	}
+
+	// Creation events only fire for new components, so classes they set up are never handed to another placement
+	TSet<UClass*> EventMeshClasses;
+	for (const FAdditionalMesh& Settings : AdditionalMeshSettings)
+	{
+		if (WantsCreationResults(Settings))
+		{
+			EventMeshClasses.Add(Settings.InstanceInfo.MeshClass);
+		}
+	}
+
+	TMap<UClass*, TArray<UStaticMeshComponent*>> FreeMeshesByClass;
+	for (const TPair<uint32, int32>& Pair : OldMeshesByHash)
+	{
+		UStaticMeshComponent* OldMesh = OldMeshes[Pair.Value];
+		if (EventMeshClasses.Contains(OldMesh->GetClass()))
+		{
+			AddDirtyBounds(OldMesh);
+			OldMesh->DestroyComponent();
+			continue;
+		}
+		FreeMeshesByClass.FindOrAdd(OldMesh->GetClass()).Add(OldMesh);
+	}
+
+	TArray<TArray<FAdditionalMeshCreationResult>> Results;
+	Results.SetNum(AdditionalMeshesNum);
+
+	for (int32 nEntry = 0; nEntry < Entries.Num(); ++nEntry)
+	{
+		const FPropEntry& Entry = Entries[nEntry];
+		const FAdditionalMeshInfo& MeshInfo = AdditionalMeshSettings[Entry.SettingsIndex].InstanceInfo;
+		UStaticMeshComponent* Component = Matches[nEntry];
+		bool bCreated = false;
+
+		if (!Component)
+		{
+			TArray<UStaticMeshComponent*>* FreeMeshes = FreeMeshesByClass.Find(MeshInfo.MeshClass);
+			const bool bReused = FreeMeshes && FreeMeshes->Num() > 0;
+			if (bReused)
+			{
+				Component = FreeMeshes->Pop();
+				AddDirtyBounds(Component);
+			}
+			else
+			{
+				Component = Cast<UStaticMeshComponent>(AddComponentByClass(MeshInfo.MeshClass, false, Spline->GetComponentTransform(), false));
+				bCreated = true;
+			}
+
+			if (IsValid(Component))
+			{
+				PlaceAdditionalMesh(Component, Transforms[nEntry], MeshInfo);
+				Component->UpdateBounds();
+				AddDirtyBounds(Component);
+
+				if (bReused)
+				{
+					FNavigationSystem::UpdateComponentData(*Component);
+				}
+			}
+		}
+
+		if (IsValid(Component))
+		{
+			SpatialIndex.AddProp(CreatedAdditionalMeshes.Add(Component), Transforms[nEntry].GetLocation());
+			CreatedAdditionalMeshIndices.Add(FIntPoint(Entry.Index, Entry.MaxIndex));
+		}
+
+		if (!bCreated || !WantsCreationResults(AdditionalMeshSettings[Entry.SettingsIndex]))
+		{
+			continue;
+		}
+
+		FAdditionalMeshCreationResult& Result = Results[Entry.SettingsIndex].AddDefaulted_GetRef();
+		Result.Index = Entry.Index;
+		Result.MaxIndex = Entry.MaxIndex;
+		Result.Component = Component;
+		Result.Transform = Transforms[nEntry];
+	}
+
+	for (const TPair<UClass*, TArray<UStaticMeshComponent*>>& Pair : FreeMeshesByClass)
+	{
+		for (UStaticMeshComponent* FreeMesh : Pair.Value)
+		{
+			AddDirtyBounds(FreeMesh);
+			FreeMesh->DestroyComponent();
+		}
+	}
+
+	NotifyAdditionalMeshesCreated(Results);
+}
+
+void AMultiMeshSpline::NativeOnAdditionalMeshesCreated(const FAdditionalMesh& Settings, const TArray<FAdditionalMeshCreationResult>& Results)
+{
+	if (Settings.bTriggerBatchedCreationEvent)
+	{
+		OnAdditionalMeshesCreated(Settings.Identifier, Results);
+	}
+}
+
+FAdditionalMeshPlacement AMultiMeshSpline::MakeAdditionalMeshPlacement(const FAdditionalMeshInfo& MeshInfo)
+{
+	FAdditionalMeshPlacement Placement;
+	Placement.LocationOffset = MeshInfo.LocationOffset;
+	Placement.RotationOffset = MeshInfo.RotationOffset;
+	Placement.Scale = MeshInfo.Scale;
+
+	if (MeshInfo.bAdjustByBounds && IsValid(MeshInfo.Mesh))
+	{
+		// Matches the local bounds of a component showing the mesh, without needing the component
+		Placement.LocationOffset -= MeshInfo.Mesh->GetBounds().Origin * MeshInfo.Scale;
+	}
+
+	return Placement;
+}
+
+void AMultiMeshSpline::GatherAdditionalMeshPlacements(TArray<FAdditionalMeshPlacement>& Placements) const
+{
+	Placements.Reserve(AdditionalMeshSettings.Num());
+	for (const FAdditionalMesh& AdditionalMesh : AdditionalMeshSettings)
+	{
+		Placements.Add(MakeAdditionalMeshPlacement(AdditionalMesh.InstanceInfo));
+	}
+}
+
+FTransform AMultiMeshSpline::ComputeAdditionalMeshTransform(const FVector& Location, const FVector& Tangent, const FAdditionalMeshPlacement& Placement)
+{
+	// The rotation offset is added to the frame rotator rather than composed with it, like props always were placed
+	return FTransform(FRotationMatrix::MakeFromX(Tangent).Rotator() + Placement.RotationOffset, Location + Placement.LocationOffset, Placement.Scale);
+}
+
+void AMultiMeshSpline::PlaceAdditionalMesh(UStaticMeshComponent* Component, const FTransform& Transform, const FAdditionalMeshInfo& MeshInfo)
+{
+	Component->SetStaticMesh(MeshInfo.Mesh);
+	Component->SetRelativeTransform(Transform);
+	Component->AttachToComponent(Spline, FAttachmentTransformRules::KeepRelativeTransform);
+}
+
+void AMultiMeshSpline::AddDirtyBounds(const UPrimitiveComponent* Component)
+{
+	if (IsValid(Component) && Component->IsRegistered())
+	{
+		LastRefreshDirtyBounds += Component->Bounds.GetBox();
+	}
+}
+
+uint32 AMultiMeshSpline::HashSplineMeshSegment(int32 LayerIndex, const UStaticMesh* SegmentMesh, const FSplineMeshParams& Params)
+{
+	return HashCombine(HashCombine(GetTypeHash(LayerIndex), GetTypeHash(SegmentMesh)), HashCombine(GetTypeHash(Params.StartPos), GetTypeHash(Params.EndPos)));
+}
+
+bool AMultiMeshSpline::AreSplineMeshParamsEqual(const FSplineMeshParams& A, const FSplineMeshParams& B)
+{
+	return A.StartPos == B.StartPos && A.StartTangent == B.StartTangent && A.StartScale == B.StartScale && A.StartRoll == B.StartRoll && A.StartOffset == B.StartOffset
+		&& A.EndPos == B.EndPos && A.EndTangent == B.EndTangent && A.EndScale == B.EndScale && A.EndRoll == B.EndRoll && A.EndOffset == B.EndOffset;
+}
+
+uint32 AMultiMeshSpline::HashAdditionalMesh(const UClass* MeshClass, const UStaticMesh* AdditionalMesh, const FVector& Location)
+{
+	return HashCombine(HashCombine(GetTypeHash(MeshClass), GetTypeHash(AdditionalMesh)), GetTypeHash(Location));
+}
+
+float AMultiMeshSpline::ConvertTimeToInputKey(float Time) const
+{
+	// Matches USplineComponent::Get*AtTime without constant velocity
+	return Spline->Duration > 0.0f ? Time * Spline->GetNumberOfSplineSegments() / Spline->Duration : 0.0f;
+}
+
+float AMultiMeshSpline::ConvertInputKeyToTime(float InputKey) const
+{
+	const int32 NumSegments = Spline->GetNumberOfSplineSegments();
+	return NumSegments > 0 ? InputKey / NumSegments * Spline->Duration : 0.0f;
+}
+
+float AMultiMeshSpline::GetKeysPerTime() const
+{
+	// Fixed while streaming, the spline grows by keys but Duration stays the same
+	if (bStreaming)
+	{
+		return StreamingKeysPerTime;
+	}
+	return Spline->Duration > 0.0f ? Spline->GetNumberOfSplineSegments() / Spline->Duration : 0.0f;
+}
+
+void AMultiMeshSpline::OnConstruction(const FTransform& Transform)
+{
+	Super::OnConstruction(Transform);
+
+	// Generated components are relative to the spline, moving the actor or editing unrelated properties changes nothing.
+	// A rerun construction script may have destroyed them though, in that case the inputs alone can't tell
+	if (ComputeInputFingerprint() != GeneratedFingerprint || HasStaleGeneratedComponents())
+	{
+		Refresh();
+	}
+
+	// Segments kept by Refresh still carry the previous body instance
+	if (bPendingCollisionUpdate)
+	{
+		UpdateCollisionInfo();
+	}
+
+	bPendingCollisionUpdate = false;
+}
+
+#if WITH_EDITOR
+void AMultiMeshSpline::PostEditChangeChainProperty(FPropertyChangedChainEvent& PropertyChangedEvent)
+{
+	// Body instance edits are left out of the fingerprint and only need UpdateCollisionInfo
+	for (const FProperty* Property : PropertyChangedEvent.PropertyChain)
+	{
+		if (IsCollisionProperty(Property))
+		{
+			bPendingCollisionUpdate = true;
+			break;
+		}
+	}
+
+	Super::PostEditChangeChainProperty(PropertyChangedEvent);
+}
+#endif
+
+bool AMultiMeshSpline::HasStaleGeneratedComponents() const
+{
+	auto IsStale = [this](const UActorComponent* Component)
+	{
+		return !IsValid(Component) || Component->GetOwner() != this;
+	};
+
+	return CreatedMeshes.ContainsByPredicate(IsStale) || CreatedAdditionalMeshes.ContainsByPredicate(IsStale)
+		|| CreatedInstancedLayers.ContainsByPredicate([&IsStale](const UInstancedStaticMeshComponent* Layer) { return Layer && IsStale(Layer); });
+}
+
+uint32 AMultiMeshSpline::ComputeInputFingerprint() const
+{
+	TArray<uint8> SplineData;
+	FMemoryWriter Writer(SplineData);
+
+	FSplineCurves& Curves = const_cast<FSplineCurves&>(Spline->SplineCurves);
+	Writer << Curves.Position;
+	Writer << Curves.Rotation;
+	Writer << Curves.Scale;
+	// Distance lookups depend on the reparam settings and loop position, the table they build covers them all
+	Writer << Curves.ReparamTable;
+
+	float Duration = Spline->Duration;
+	bool bClosedLoop = Spline->IsClosedLoop();
+	bool bStationaryEndpoints = Spline->bStationaryEndpoints;
+	int32 ReparamStepsPerSegment = Spline->ReparamStepsPerSegment;
+	FVector DefaultUpVector = Spline->DefaultUpVector;
+	Writer << Duration;
+	Writer << bClosedLoop;
+	Writer << bStationaryEndpoints;
+	Writer << ReparamStepsPerSegment;
+	Writer << DefaultUpVector;
+
+	uint32 Hash = FCrc::MemCrc32(SplineData.GetData(), SplineData.Num());
+
+	// Generation settings are every editable property declared by this class or a subclass
+	for (TFieldIterator<FProperty> It(GetClass()); It; ++It)
+	{
+		const FProperty* Property = *It;
+		if (!Property->HasAnyPropertyFlags(CPF_Edit) || !Property->GetOwnerClass()->IsChildOf(AMultiMeshSpline::StaticClass())
+			|| Property->GetFName() == GET_MEMBER_NAME_CHECKED(AMultiMeshSpline, Spline))
+		{
+			continue;
+		}
+
+		for (int32 nElement = 0; nElement < Property->ArrayDim; ++nElement)
+		{
+			HashPropertyValue(Property, Property->ContainerPtrToValuePtr<void>(this, nElement), Hash);
+		}
+	}
+
+	return Hash;
+}
+
+void AMultiMeshSpline::HashPropertyValue(const FProperty* Property, const void* Value, uint32& Hash)
+{
+	if (IsCollisionProperty(Property))
+	{
+		return;
+	}
+
+	if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+	{
+		for (TFieldIterator<FProperty> It(StructProperty->Struct); It; ++It)
+		{
+			for (int32 nElement = 0; nElement < It->ArrayDim; ++nElement)
+			{
+				HashPropertyValue(*It, It->ContainerPtrToValuePtr<void>(Value, nElement), Hash);
+			}
+		}
+		return;
+	}
+
+	if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property))
+	{
+		FScriptArrayHelper ArrayHelper(ArrayProperty, Value);
+		Hash = HashCombine(Hash, GetTypeHash(ArrayHelper.Num()));
+		for (int32 nElement = 0; nElement < ArrayHelper.Num(); ++nElement)
+		{
+			HashPropertyValue(ArrayProperty->Inner, ArrayHelper.GetRawPtr(nElement), Hash);
+		}
+		return;
+	}
+
+	// Numbers, names, enums and object references hash their value directly, this runs on every construction while dragging
+	if (Property->HasAnyPropertyFlags(CPF_HasGetValueTypeHash))
+	{
+		Hash = HashCombine(Hash, Property->GetValueTypeHash(Value));
+
+		// A reimported or edited mesh keeps its pointer, but its bounds place props and size the instanced layers
+		if (const FObjectPropertyBase* ObjectProperty = CastField<FObjectPropertyBase>(Property))
+		{
+			if (const UStaticMesh* StaticMesh = Cast<UStaticMesh>(ObjectProperty->GetObjectPropertyValue(Value)))
+			{
+				const FBoxSphereBounds Bounds = StaticMesh->GetBounds();
+				Hash = HashCombine(Hash, HashCombine(GetTypeHash(Bounds.Origin), GetTypeHash(Bounds.BoxExtent)));
+			}
+		}
+		return;
+	}
+
+	FString Text;
+	Property->ExportTextItem_Direct(Text, Value, nullptr, nullptr, PPF_None);
+	Hash = HashCombine(Hash, FCrc::StrCrc32(*Text));
+}
+
+bool AMultiMeshSpline::IsCollisionProperty(const FProperty* Property)
+{
+	if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+	{
+		return StructProperty->Struct == FBodyInstance::StaticStruct();
+	}
+	return Property && Property->GetFName() == GET_MEMBER_NAME_CHECKED(FSplineMeshLayer, bOverrideCollision);
+}
+
+void AMultiMeshSpline::UpdateCollisionInfo()
+{
+	for (int32 nMesh = 0; nMesh < CreatedMeshes.Num(); ++nMesh)
+	{
+		// Hidden segments are pooled by TrimHeadPoints and stay without collision until reused
+		USplineMeshComponent* CreatedMesh = CreatedMeshes[nMesh];
+		if (CreatedMesh && CreatedMesh->IsVisible())
+		{
+			const int32 LayerIndex = CreatedMeshLayers.IsValidIndex(nMesh) ? CreatedMeshLayers[nMesh] : 0;
+			CreatedMesh->BodyInstance.CopyRuntimeBodyInstancePropertiesFrom(&GetLayerBodyInstance(LayerIndex));
+		}
+	}
+}
+
+void AMultiMeshSpline::DestroyGeneratedComponents()
+{
+	for (USplineMeshComponent* CreatedMesh : CreatedMeshes)
+	{
+		if (CreatedMesh)
+		{
+			AddDirtyBounds(CreatedMesh);
+			CreatedMesh->DestroyComponent();
+		}
+	}
+	for (UStaticMeshComponent* CreatedMesh : CreatedAdditionalMeshes)
+	{
+		if (CreatedMesh)
+		{
+			AddDirtyBounds(CreatedMesh);
+			CreatedMesh->DestroyComponent();
+		}
+	}
+	for (UInstancedStaticMeshComponent* CreatedLayer : CreatedInstancedLayers)
+	{
+		if (CreatedLayer)
+		{
+			AddDirtyBounds(CreatedLayer);
+			CreatedLayer->DestroyComponent();
+		}
+	}
+	CreatedInstancedLayers.Empty();
+	CreatedAdditionalMeshes.Empty();
+	CreatedAdditionalMeshIndices.Empty();
+	CreatedMeshes.Empty();
+	CreatedMeshLayers.Empty();
+	CreatedMeshKeys.Empty();
+	CreatedInstancedKeys.Empty();
+	CreatedKeyOffset = 0.0f;
+	SpatialIndex.Reset();
+
+	GeneratedFingerprint = 0;
+	bStreaming = false;
+	StreamedSpans.Empty();
+	StreamedSpanHead = 0;
+	TrimmedDistance = 0.0;
+	FreeSegmentsByLayer.Empty();
+	FreePropsByClass.Empty();
+	StreamingSpacings.Empty();
+	StreamingKeysPerTime = 0.0f;
+}
+
+void AMultiMeshSpline::Refresh()
+{
+	// Only added, reshaped and removed components reach navigation, each dirties its own bounds and the
+	// navigation system rebuilds the tiles under all of them together on its next update
+	LastRefreshDirtyBounds.Init();
+
+	if (bStreaming)
+	{
+		// Streamed components are movable and indexed by span, they aren't diffed against. Copies of a streamed actor
+		// come without bStreaming, the diff drops their hidden pooled components itself
+		DestroyGeneratedComponents();
+	}
+
+	SpatialIndex.Reset();
+	CreatedMeshKeys.Reset();
+	CreatedInstancedKeys.Reset();
+	CreatedKeyOffset = 0.0f;
+	GenerateSplineMeshes();
+	GenerateAdditionalMeshes();
+
+	SpatialIndex.Build(Spline);
+	GeneratedFingerprint = ComputeInputFingerprint();
+
+	UE_LOG(LogSplineHelper, Verbose, TEXT("%s: refresh dirtied %s"), *GetName(),
+		LastRefreshDirtyBounds.IsValid ? *LastRefreshDirtyBounds.ToString() : TEXT("nothing"));
+}
+
+FVector AMultiMeshSpline::FindClosestPointOnSpline(const FVector& WorldLocation, float& OutTime)
+{
+	const FTransform& SplineTransform = Spline->GetComponentTransform();
+
+	EnsureSpatialIndex();
+
+	FSplineSpatialIndex::FClosestPointResult Result;
+	if (!SpatialIndex.FindClosestPoint(Spline, SplineTransform.InverseTransformPosition(WorldLocation), Result))
+	{
+		const float InputKey = Spline->FindInputKeyClosestToWorldLocation(WorldLocation);
+		OutTime = ConvertInputKeyToTime(InputKey);
+		return Spline->GetLocationAtSplineInputKey(InputKey, ESplineCoordinateSpace::World);
+	}
+
+	OutTime = ConvertInputKeyToTime(Result.InputKey);
+	return SplineTransform.TransformPosition(Result.Location);
+}
+
+USplineMeshComponent* AMultiMeshSpline::FindSegmentClosestToLocation(const FVector& WorldLocation)
+{
+	EnsureSpatialIndex();
+
+	FSplineSpatialIndex::FClosestPointResult Result;
+	if (!SpatialIndex.FindClosestPoint(Spline, Spline->GetComponentTransform().InverseTransformPosition(WorldLocation), Result))
+	{
+		return nullptr;
+	}
+	return CreatedMeshes.IsValidIndex(Result.SegmentIndex) ? CreatedMeshes[Result.SegmentIndex] : nullptr;
+}
+
+USplineMeshComponent* AMultiMeshSpline::FindSegmentAtTime(float Time)
+{
+	EnsureSpatialIndex();
+
+	const int32 SegmentIndex = SpatialIndex.FindSegmentAtInputKey(ConvertTimeToInputKey(Time));
+	return CreatedMeshes.IsValidIndex(SegmentIndex) ? CreatedMeshes[SegmentIndex] : nullptr;
+}
+
+TArray<UStaticMeshComponent*> AMultiMeshSpline::FindAdditionalMeshesInRadius(const FVector& WorldLocation, float Radius)
+{
+	EnsureSpatialIndex();
+
+	TArray<UStaticMeshComponent*> Result;
+	const FTransform& SplineTransform = Spline->GetComponentTransform();
+
+	// The index lives in spline space, query with a radius that covers any non uniform scale and filter in world space afterwards
+	const float MinScale = FMath::Max(SplineTransform.GetScale3D().GetAbsMin(), UE_KINDA_SMALL_NUMBER);
+	TArray<int32> PropIndices;
+	SpatialIndex.FindPropsInRadius(SplineTransform.InverseTransformPosition(WorldLocation), Radius / MinScale, PropIndices);
+
+	for (const int32 PropIndex : PropIndices)
+	{
+		UStaticMeshComponent* Component = CreatedAdditionalMeshes.IsValidIndex(PropIndex) ? CreatedAdditionalMeshes[PropIndex] : nullptr;
+		if (IsValid(Component) && FVector::DistSquared(Component->GetComponentLocation(), WorldLocation) <= FMath::Square(Radius))
+		{
+			Result.Add(Component);
+		}
+	}
+	return Result;
+}
+
+void AMultiMeshSpline::EnsureSpatialIndex()
+{
+	if (!SpatialIndex.IsBuilt())
+	{
+		if (SpatialIndex.IsEmpty())
+		{
+			RestoreSpatialIndex();
+		}
+		SpatialIndex.Build(Spline);
+	}
+}
+
+void AMultiMeshSpline::RegisterSpatialSegment(int32 SegmentIndex, float StartKey, float EndKey)
+{
+	SpatialIndex.AddSegment(SegmentIndex, StartKey, EndKey);
+
+	// MakeInstancedSegmentId is its own inverse, it turns an instanced id back into the instance index
+	TArray<FVector2f>& Keys = SegmentIndex >= 0 ? CreatedMeshKeys : CreatedInstancedKeys;
+	const int32 KeyIndex = SegmentIndex >= 0 ? SegmentIndex : MakeInstancedSegmentId(SegmentIndex);
+	while (Keys.Num() <= KeyIndex)
+	{
+		Keys.Add(FVector2f(-1.0f));
+	}
+	Keys[KeyIndex] = FVector2f(StartKey - CreatedKeyOffset, EndKey - CreatedKeyOffset);
+}
+
+void AMultiMeshSpline::UnregisterSpatialSegment(int32 SegmentIndex)
+{
+	SpatialIndex.RemoveSegment(SegmentIndex);
+	if (CreatedMeshKeys.IsValidIndex(SegmentIndex))
+	{
+		CreatedMeshKeys[SegmentIndex] = FVector2f(-1.0f);
+	}
+}
+
+void AMultiMeshSpline::RestoreSpatialIndex()
+{
+	SpatialIndex.Reset();
+	SpatialIndex.ShiftKeys(CreatedKeyOffset);
+
+	// Keys are stored relative to the untrimmed spline, so they are never negative once registered
+	for (int32 nMesh = 0; nMesh < FMath::Min(CreatedMeshes.Num(), CreatedMeshKeys.Num()); ++nMesh)
+	{
+		const FVector2f& Keys = CreatedMeshKeys[nMesh];
+		if (Keys.X >= 0.0f && IsValid(CreatedMeshes[nMesh]))
+		{
+			SpatialIndex.AddSegment(nMesh, Keys.X + CreatedKeyOffset, Keys.Y + CreatedKeyOffset);
+		}
+	}
+
+	for (int32 nInstance = 0; nInstance < CreatedInstancedKeys.Num(); ++nInstance)
+	{
+		const FVector2f& Keys = CreatedInstancedKeys[nInstance];
+		SpatialIndex.AddSegment(MakeInstancedSegmentId(nInstance), Keys.X + CreatedKeyOffset, Keys.Y + CreatedKeyOffset);
+	}
+
+	// Pooled streaming props are hidden, the visible ones are the live ones
+	for (int32 nProp = 0; nProp < CreatedAdditionalMeshes.Num(); ++nProp)
+	{
+		const UStaticMeshComponent* Component = CreatedAdditionalMeshes[nProp];
+		if (IsValid(Component) && Component->IsVisible())
+		{
+			SpatialIndex.AddProp(nProp, Component->GetRelativeLocation());
+		}
+	}
+}
+
+void AMultiMeshSpline::AppendTailPoints(const TArray<FVector>& Points, ESplineCoordinateSpace::Type CoordinateSpace)
+{
+	if (Points.IsEmpty())
+	{
+		return;
+	}
+
+	if (Spline->IsClosedLoop())
+	{
+		UE_LOG(LogSplineHelper, Warning, TEXT("%s: AppendTailPoints needs an open spline"), *GetName());
+		return;
+	}
+
+	if (!bStreaming)
+	{
+		BeginStreaming();
+	}
+
+	const int32 OldNumPoints = Spline->GetNumberOfSplinePoints();
+	for (const FVector& Point : Points)
+	{
+		Spline->AddSplinePoint(Point, CoordinateSpace, false);
+	}
+	Spline->UpdateSpline();
+
+	// The previous last span changes shape too, its end tangent now sees the new neighbour
+	GenerateStreamedSpans(FMath::Max(OldNumPoints - 2, 0), Spline->GetNumberOfSplinePoints() - 1);
+}
+
+void AMultiMeshSpline::TrimHeadPoints(int32 NumPoints)
+{
+	if (!bStreaming)
+	{
+		BeginStreaming();
+	}
+
+	NumPoints = FMath::Min(NumPoints, Spline->GetNumberOfSplinePoints() - 2);
+	if (NumPoints <= 0)
+	{
+		return;
+	}
+
+	// The first kept span changes shape with its new start tangent, the grid is anchored at the end of it instead
+	const double AnchorDistance = Spline->GetDistanceAlongSplineAtSplinePoint(NumPoints + 1);
+
+	for (int32 nSpan = 0; nSpan < NumPoints; ++nSpan)
+	{
+		RecycleStreamedSpan(StreamedSpans[StreamedSpanHead + nSpan]);
+	}
+
+	// Spans behave like a ring buffer, the dead head is only compacted once it outgrows the live part
+	StreamedSpanHead += NumPoints;
+	if (StreamedSpanHead * 2 > StreamedSpans.Num())
+	{
+		StreamedSpans.RemoveAt(0, StreamedSpanHead);
+		StreamedSpanHead = 0;
+	}
+
+	Spline->RemoveFirstSplinePoints(NumPoints);
+	SpatialIndex.ShiftKeys(-NumPoints);
+	CreatedKeyOffset -= NumPoints;
+	TrimmedDistance += AnchorDistance - Spline->GetDistanceAlongSplineAtSplinePoint(1);
+
+	// The new first span lost its neighbour, regenerate it with the new start tangent
+	GenerateStreamedSpans(0, 1);
+}
+
+void AMultiMeshSpline::BeginStreaming()
+{
+	DestroyGeneratedComponents();
+
+	// Segment intervals are converted to keys with the spline as it is now, so spans appended later are segmented alike
+	StreamingKeysPerTime = GetKeysPerTime();
+	bStreaming = true;
+
+	TArray<FSplineMeshLayer> Layers;
+	GatherMeshLayers(Layers);
+
+	for (int32 nLayer = 0; nLayer < Layers.Num(); ++nLayer)
+	{
+		if (Layers[nLayer].bInstanced && IsValid(Layers[nLayer].Mesh))
+		{
+			UE_LOG(LogSplineHelper, Warning, TEXT("%s: layer %d is instanced, streamed spans generate spline mesh components for it"), *GetName(), nLayer);
+		}
+	}
+
+	// Spacings are fixed now, the spline length keeps changing while streaming and the grid has to stay put
+	StreamingSpacings.Init(0.0, AdditionalMeshSettings.Num());
+	for (int32 nAdditionalMesh = 0; nAdditionalMesh < AdditionalMeshSettings.Num(); ++nAdditionalMesh)
+	{
+		const FAdditionalMesh& CurrentAdditionalMesh = AdditionalMeshSettings[nAdditionalMesh];
+		const FAdditionalMeshRepetitionParams& CurrentRepetitionInfo = CurrentAdditionalMesh.RepetitionInfo;
+
+		if (CurrentRepetitionInfo.Type != ERepetitionType::Always)
+		{
+			UE_LOG(LogSplineHelper, Warning, TEXT("%s: additional mesh %s only repeats along ranges, it is skipped while streaming"), *GetName(), *CurrentAdditionalMesh.Identifier.ToString());
+		}
+		else if (CurrentRepetitionInfo.StreamingSpacing > UE_KINDA_SMALL_NUMBER)
+		{
+			StreamingSpacings[nAdditionalMesh] = CurrentRepetitionInfo.StreamingSpacing;
+		}
+		else if (!FMath::IsNearlyZero(CurrentRepetitionInfo.Repetition) && Spline->Duration > 0.0f)
+		{
+			// Same average spacing Repetition gives on the spline as it is now
+			StreamingSpacings[nAdditionalMesh] = FMath::Max(CurrentRepetitionInfo.Repetition, 0.009f) / Spline->Duration * Spline->GetSplineLength();
+		}
+	}
+
+	GenerateStreamedSpans(0, Spline->GetNumberOfSplinePoints() - 1);
+}
+
+void AMultiMeshSpline::GenerateStreamedSpans(int32 FirstSpan, int32 EndSpan)
+{
+	TArray<FSplineMeshLayer> Layers;
+	GatherMeshLayers(Layers);
+	TArray<FAdditionalMeshPlacement> Placements;
+	GatherAdditionalMeshPlacements(Placements);
+	TArray<TArray<FAdditionalMeshCreationResult>> Results;
+	Results.SetNum(AdditionalMeshSettings.Num());
+
+	for (int32 nSpan = FirstSpan; nSpan < EndSpan; ++nSpan)
+	{
+		GenerateStreamedSpan(nSpan, Layers, Placements, Results);
+	}
+
+	NotifyAdditionalMeshesCreated(Results);
+}
+
+void AMultiMeshSpline::GenerateStreamedSpan(int32 SpanIndex, const TArray<FSplineMeshLayer>& Layers, const TArray<FAdditionalMeshPlacement>& Placements, TArray<TArray<FAdditionalMeshCreationResult>>& Results)
+{
+	const int32 SpanSlot = StreamedSpanHead + SpanIndex;
+	if (SpanSlot >= StreamedSpans.Num())
+	{
+		StreamedSpans.SetNum(SpanSlot + 1);
+	}
+
+	FStreamedSpan& Span = StreamedSpans[SpanSlot];
+	RecycleStreamedSegments(Span);
+
+	// Every layer segments the span with its own SplineType
+	FLayerSegmentation Segmentation;
+	SegmentLayers(Layers, GetKeysPerTime(), SpanIndex, SpanIndex + 1, Segmentation);
+
+	for (int32 nLayer = 0; nLayer < Layers.Num(); ++nLayer)
+	{
+		const FSplineMeshLayer& Layer = Layers[nLayer];
+		const TArray<float>& SegmentKeys = Segmentation.LayerKeys[nLayer];
+
+		for (int32 i = 0; i < SegmentKeys.Num() - 1; i++)
+		{
+			const int32 SegmentIndex = AcquireStreamedSegment(nLayer);
+			USplineMeshComponent* Component = CreatedMeshes.IsValidIndex(SegmentIndex) ? CreatedMeshes[SegmentIndex] : nullptr;
+			if (!IsValid(Component))
+			{
+				continue;
+			}
+
+			ApplySplineMeshLayer(Component, Layer, nLayer, MakeLayerSegmentParams(Layer, Segmentation, SegmentKeys[i], SegmentKeys[i + 1]));
+			Span.Segments.Add(SegmentIndex);
+
+			if (nLayer == 0)
+			{
+				RegisterSpatialSegment(SegmentIndex, SegmentKeys[i], SegmentKeys[i + 1]);
+			}
+		}
+	}
+
+	RecycleStreamedProps(Span);
+
+	// Props sit on a fixed distance grid measured from the original start, so trimming and appending never shifts them
+	const double SpanStart = Spline->GetDistanceAlongSplineAtSplinePoint(SpanIndex);
+	const double SpanEnd = Spline->GetDistanceAlongSplineAtSplinePoint(SpanIndex + 1);
+
+	for (int32 nAdditionalMesh = 0; nAdditionalMesh < AdditionalMeshSettings.Num(); ++nAdditionalMesh)
+	{
+		const FAdditionalMesh& CurrentAdditionalMesh = AdditionalMeshSettings[nAdditionalMesh];
+		const FAdditionalMeshInfo& CurrentMeshInfo = CurrentAdditionalMesh.InstanceInfo;
+		const double Spacing = StreamingSpacings.IsValidIndex(nAdditionalMesh) ? StreamingSpacings[nAdditionalMesh] : 0.0;
+
+		if (Spacing <= UE_KINDA_SMALL_NUMBER || !IsValid(CurrentMeshInfo.Mesh) || !IsValid(CurrentMeshInfo.MeshClass))
+		{
+			continue;
+		}
+
+		for (int64 GridIndex = FMath::CeilToInt64((TrimmedDistance + SpanStart) / Spacing); GridIndex * Spacing - TrimmedDistance < SpanEnd; ++GridIndex)
+		{
+			const int32 PropIndex = AcquireStreamedProp(CurrentMeshInfo.MeshClass);
+			UStaticMeshComponent* Component = CreatedAdditionalMeshes.IsValidIndex(PropIndex) ? CreatedAdditionalMeshes[PropIndex] : nullptr;
+			if (!IsValid(Component))
+			{
+				continue;
+			}
+
+			const float Distance = GridIndex * Spacing - TrimmedDistance;
+			PlaceAdditionalMesh(Component, ComputeAdditionalMeshTransform(
+				Spline->GetLocationAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::Local),
+				Spline->GetTangentAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::Local),
+				Placements[nAdditionalMesh]), CurrentMeshInfo);
+
+			Span.Props.Add(PropIndex);
+			SpatialIndex.AddProp(PropIndex, Component->GetRelativeLocation());
+			CreatedAdditionalMeshIndices[PropIndex] = FIntPoint(static_cast<int32>(GridIndex), INDEX_NONE);
+
+			if (!WantsCreationResults(CurrentAdditionalMesh))
+			{
+				continue;
+			}
+
+			FAdditionalMeshCreationResult& Result = Results[nAdditionalMesh].AddDefaulted_GetRef();
+			Result.Index = static_cast<int32>(GridIndex);
+			Result.MaxIndex = INDEX_NONE;
+			Result.Component = Component;
+			Result.Transform = Component->GetRelativeTransform();
+		}
+	}
+}
+
+void AMultiMeshSpline::RecycleStreamedSpan(FStreamedSpan& Span)
+{
+	RecycleStreamedSegments(Span);
+	RecycleStreamedProps(Span);
+}
+
+void AMultiMeshSpline::RecycleStreamedSegments(FStreamedSpan& Span)
+{
+	for (const int32 SegmentIndex : Span.Segments)
+	{
+		USplineMeshComponent* Component = CreatedMeshes.IsValidIndex(SegmentIndex) ? CreatedMeshes[SegmentIndex] : nullptr;
+		if (!IsValid(Component))
+		{
+			continue;
+		}
+
+		Component->SetVisibility(false);
+		Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		UnregisterSpatialSegment(SegmentIndex);
+
+		const int32 LayerIndex = CreatedMeshLayers[SegmentIndex];
+		if (FreeSegmentsByLayer.Num() <= LayerIndex)
+		{
+			FreeSegmentsByLayer.SetNum(LayerIndex + 1);
+		}
+		FreeSegmentsByLayer[LayerIndex].Add(SegmentIndex);
+	}
+	Span.Segments.Reset();
+}
+
+void AMultiMeshSpline::RecycleStreamedProps(FStreamedSpan& Span)
+{
+	for (const int32 PropIndex : Span.Props)
+	{
+		UStaticMeshComponent* Component = CreatedAdditionalMeshes.IsValidIndex(PropIndex) ? CreatedAdditionalMeshes[PropIndex] : nullptr;
+		if (!IsValid(Component))
+		{
+			continue;
+		}
+
+		Component->SetVisibility(false);
+		Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		SpatialIndex.RemoveProp(PropIndex);
+		FreePropsByClass.FindOrAdd(Component->GetClass()).Add(PropIndex);
+	}
+	Span.Props.Reset();
+}
+
+int32 AMultiMeshSpline::AcquireStreamedSegment(int32 LayerIndex)
+{
+	if (FreeSegmentsByLayer.IsValidIndex(LayerIndex) && FreeSegmentsByLayer[LayerIndex].Num() > 0)
+	{
+		const int32 SegmentIndex = FreeSegmentsByLayer[LayerIndex].Pop();
+		CreatedMeshes[SegmentIndex]->SetVisibility(true);
+		return SegmentIndex;
+	}
+
+	return AddSplineMeshComponent(LayerIndex, EComponentMobility::Movable) ? CreatedMeshes.Num() - 1 : INDEX_NONE;
+}
+
+int32 AMultiMeshSpline::AcquireStreamedProp(UClass* MeshClass)
+{
+	if (TArray<int32>* FreeProps = FreePropsByClass.Find(MeshClass); FreeProps && FreeProps->Num() > 0)
+	{
+		const int32 PropIndex = FreeProps->Pop(false);
+		UStaticMeshComponent* Component = CreatedAdditionalMeshes[PropIndex];
+		Component->SetVisibility(true);
+		Component->SetCollisionEnabled(MeshClass->GetDefaultObject<UStaticMeshComponent>()->GetCollisionEnabled());
+		return PropIndex;
+	}
+
+	UStaticMeshComponent* Component = Cast<UStaticMeshComponent>(AddComponentByClass(MeshClass, false, Spline->GetComponentTransform(), false));
+	if (!IsValid(Component))
+	{
+		return INDEX_NONE;
+	}
+
+	Component->SetMobility(EComponentMobility::Movable);
+	const int32 PropIndex = CreatedAdditionalMeshes.Add(Component);
+	// Also pads the indices of components saved before they were recorded
+	CreatedAdditionalMeshIndices.SetNum(CreatedAdditionalMeshes.Num());
+	return PropIndex;
+}
+
+void AMultiMeshSpline::NotifyAdditionalMeshesCreated(const TArray<TArray<FAdditionalMeshCreationResult>>& Results)
+{
+	for (int32 nAdditionalMesh = 0; nAdditionalMesh < Results.Num(); ++nAdditionalMesh)
+	{
+		const FAdditionalMesh& CurrentAdditionalMesh = AdditionalMeshSettings[nAdditionalMesh];
+		if (Results[nAdditionalMesh].IsEmpty())
+		{
+			continue;
+		}
+
+		if (CurrentAdditionalMesh.bTriggerCreationEvent)
+		{
+			for (const FAdditionalMeshCreationResult& Result : Results[nAdditionalMesh])
+			{
+				OnAdditionalMeshCreated(Result.Index, Result.MaxIndex, CurrentAdditionalMesh.Identifier, Result.Component);
+			}
+		}
+
+		NativeOnAdditionalMeshesCreated(CurrentAdditionalMesh, Results[nAdditionalMesh]);
 	}
-	
-	GenerateAdditionalMeshes();
 }
 
 void AMultiMeshSpline::Tick(float DeltaTime)
@@ -0,0 +1,287 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SplineBatchEvaluator.h"
+
+#include "Algo/IsSorted.h"
+#include "Components/SplineComponent.h"
+
+namespace
+{
+	/**
+	 * Walks forward through the points of a curve. The first key of a batch, a key lower than the previous one
+	 * and a key more than a few points ahead are found with the curve's binary search instead.
+	 */
+	struct FCurveCursor
+	{
+		static constexpr int32 MaxWalkedPoints = 4;
+
+		int32 Index = INDEX_NONE;
+
+		/** False outside the interior segments (clamped ends and the loop segment), FInterpCurve::Eval handles those */
+		template<typename T>
+		bool Seek(const FInterpCurve<T>& Curve, float Key, float& OutAlpha, float& OutDiff)
+		{
+			const TArray<FInterpCurvePoint<T>>& Points = Curve.Points;
+			if (Points.Num() < 2 || Key < Points[0].InVal || Key >= Points.Last().InVal)
+			{
+				return false;
+			}
+
+			if (Index == INDEX_NONE || Key < Points[Index].InVal)
+			{
+				Index = Curve.GetPointIndexForInputValue(Key);
+			}
+
+			for (int32 nWalked = 0; Points[Index + 1].InVal <= Key; ++nWalked)
+			{
+				if (nWalked == MaxWalkedPoints)
+				{
+					Index = Curve.GetPointIndexForInputValue(Key);
+					break;
+				}
+				++Index;
+			}
+
+			OutDiff = Points[Index + 1].InVal - Points[Index].InVal;
+			OutAlpha = (Key - Points[Index].InVal) / OutDiff;
+			return true;
+		}
+	};
+
+	/** Same as FInterpCurve::Eval without the point search */
+	template<typename T>
+	T EvalCurve(const FInterpCurve<T>& Curve, FCurveCursor& Cursor, float Key, const T& Default)
+	{
+		float Alpha;
+		float Diff;
+		if (!Cursor.Seek(Curve, Key, Alpha, Diff))
+		{
+			return Curve.Eval(Key, Default);
+		}
+
+		const FInterpCurvePoint<T>& Prev = Curve.Points[Cursor.Index];
+		const FInterpCurvePoint<T>& Next = Curve.Points[Cursor.Index + 1];
+
+		if (Prev.InterpMode == CIM_Constant)
+		{
+			return Prev.OutVal;
+		}
+		if (Prev.InterpMode == CIM_Linear)
+		{
+			return FMath::Lerp(Prev.OutVal, Next.OutVal, Alpha);
+		}
+		return FMath::CubicInterp(Prev.OutVal, Prev.LeaveTangent * Diff, Next.OutVal, Next.ArriveTangent * Diff, Alpha);
+	}
+}
+
+void FSplineBatchEvaluator::EvaluateAtInputKeys(const USplineComponent* Spline, TConstArrayView<float> InputKeys, FSplineBatchSamples& OutSamples)
+{
+	checkSlow(Algo::IsSorted(InputKeys));
+
+	const FSplineCurves& Curves = Spline->SplineCurves;
+
+	EvaluateVectorCurve(Curves.Position, InputKeys, FVector::ZeroVector, OutSamples.Locations, &OutSamples.Tangents);
+	EvaluateVectorCurve(Curves.Scale, InputKeys, FVector(1.0f), OutSamples.Scales, nullptr);
+
+	// Roll depends on the tangent direction, so it follows USplineComponent::GetQuaternionAtSplineInputKey per sample
+	OutSamples.Rolls.SetNumUninitialized(InputKeys.Num());
+	FCurveCursor RotationCursor;
+	for (int32 nKey = 0; nKey < InputKeys.Num(); ++nKey)
+	{
+		FQuat Quat = EvalCurve(Curves.Rotation, RotationCursor, InputKeys[nKey], FQuat::Identity);
+		Quat.Normalize();
+
+		const FVector Direction = OutSamples.Tangents[nKey].GetSafeNormal();
+		const FVector UpVector = Quat.RotateVector(Spline->DefaultUpVector);
+		OutSamples.Rolls[nKey] = FRotationMatrix::MakeFromXZ(Direction, UpVector).ToQuat().Rotator().Roll;
+	}
+}
+
+void FSplineBatchEvaluator::EvaluateAtTimes(const USplineComponent* Spline, TConstArrayView<float> Times, FSplineBatchSamples& OutSamples)
+{
+	ConvertTimesToInputKeys(Spline, Times, OutSamples.InputKeys);
+	EvaluateAtInputKeys(Spline, OutSamples.InputKeys, OutSamples);
+}
+
+void FSplineBatchEvaluator::EvaluatePositionsAtInputKeys(const USplineComponent* Spline, TConstArrayView<float> InputKeys, TArray<FVector>& OutLocations, TArray<FVector>& OutTangents)
+{
+	checkSlow(Algo::IsSorted(InputKeys));
+	EvaluateVectorCurve(Spline->SplineCurves.Position, InputKeys, FVector::ZeroVector, OutLocations, &OutTangents);
+}
+
+void FSplineBatchEvaluator::EvaluatePositionsAtTimes(const USplineComponent* Spline, TConstArrayView<float> Times, TArray<FVector>& OutLocations, TArray<FVector>& OutTangents)
+{
+	TArray<float> InputKeys;
+	ConvertTimesToInputKeys(Spline, Times, InputKeys);
+	EvaluatePositionsAtInputKeys(Spline, InputKeys, OutLocations, OutTangents);
+}
+
+void FSplineBatchEvaluator::EvaluateAtTimesScalar(const USplineComponent* Spline, TConstArrayView<float> Times, FSplineBatchSamples& OutSamples)
+{
+	OutSamples.Locations.SetNumUninitialized(Times.Num());
+	OutSamples.Tangents.SetNumUninitialized(Times.Num());
+	OutSamples.Scales.SetNumUninitialized(Times.Num());
+	OutSamples.Rolls.SetNumUninitialized(Times.Num());
+
+	for (int32 nTime = 0; nTime < Times.Num(); ++nTime)
+	{
+		OutSamples.Locations[nTime] = Spline->GetLocationAtTime(Times[nTime], ESplineCoordinateSpace::Local);
+		OutSamples.Tangents[nTime] = Spline->GetTangentAtTime(Times[nTime], ESplineCoordinateSpace::Local);
+		OutSamples.Scales[nTime] = Spline->GetScaleAtTime(Times[nTime]);
+		OutSamples.Rolls[nTime] = Spline->GetRollAtTime(Times[nTime], ESplineCoordinateSpace::Local);
+	}
+}
+
+void FSplineBatchEvaluator::ConvertTimesToInputKeys(const USplineComponent* Spline, TConstArrayView<float> Times, TArray<float>& OutInputKeys)
+{
+	OutInputKeys.SetNumUninitialized(Times.Num());
+
+	if (Spline->Duration <= 0.0f)
+	{
+		FMemory::Memzero(OutInputKeys.GetData(), OutInputKeys.Num() * sizeof(float));
+		return;
+	}
+
+	const float TimeMultiplier = Spline->GetNumberOfSplineSegments() / Spline->Duration;
+	for (int32 nTime = 0; nTime < Times.Num(); ++nTime)
+	{
+		OutInputKeys[nTime] = Times[nTime] * TimeMultiplier;
+	}
+}
+
+void FSplineBatchEvaluator::EvaluateVectorCurve(const FInterpCurveVector& Curve, TConstArrayView<float> InputKeys, const FVector& Default, TArray<FVector>& OutValues, TArray<FVector>* OutDerivatives)
+{
+	const int32 NumKeys = InputKeys.Num();
+	OutValues.SetNumUninitialized(NumKeys);
+	if (OutDerivatives)
+	{
+		OutDerivatives->SetNumUninitialized(NumKeys);
+	}
+
+	// One batch in structure of arrays layout, lane L evaluates the cubic segment of sample Lanes[L]
+	alignas(32) double Alpha[LaneCount];
+	alignas(32) double InvDiff[LaneCount];
+	alignas(32) double P0[3][LaneCount];
+	alignas(32) double T0[3][LaneCount];
+	alignas(32) double P1[3][LaneCount];
+	alignas(32) double T1[3][LaneCount];
+	alignas(32) double Values[3][LaneCount];
+	alignas(32) double Derivatives[3][LaneCount];
+	int32 Lanes[LaneCount];
+	int32 NumLanes = 0;
+
+	auto FlushLanes = [&]()
+	{
+		if (NumLanes == 0)
+		{
+			return;
+		}
+
+		for (int32 nLane = NumLanes; nLane < LaneCount; ++nLane)
+		{
+			Alpha[nLane] = 0.0;
+			InvDiff[nLane] = 0.0;
+			for (int32 nAxis = 0; nAxis < 3; ++nAxis)
+			{
+				P0[nAxis][nLane] = T0[nAxis][nLane] = P1[nAxis][nLane] = T1[nAxis][nLane] = 0.0;
+			}
+		}
+
+		const VectorRegister4Double One = MakeVectorRegisterDouble(1.0, 1.0, 1.0, 1.0);
+		const VectorRegister4Double Two = MakeVectorRegisterDouble(2.0, 2.0, 2.0, 2.0);
+		const VectorRegister4Double Three = MakeVectorRegisterDouble(3.0, 3.0, 3.0, 3.0);
+		const VectorRegister4Double Four = MakeVectorRegisterDouble(4.0, 4.0, 4.0, 4.0);
+		const VectorRegister4Double Six = MakeVectorRegisterDouble(6.0, 6.0, 6.0, 6.0);
+
+		const VectorRegister4Double A = VectorLoadAligned(Alpha);
+		const VectorRegister4Double A2 = VectorMultiply(A, A);
+		const VectorRegister4Double A3 = VectorMultiply(A2, A);
+
+		// Hermite basis, same terms as FMath::CubicInterp
+		const VectorRegister4Double H00 = VectorAdd(VectorSubtract(VectorMultiply(Two, A3), VectorMultiply(Three, A2)), One);
+		const VectorRegister4Double H10 = VectorAdd(VectorSubtract(A3, VectorMultiply(Two, A2)), A);
+		const VectorRegister4Double H01 = VectorSubtract(VectorMultiply(Three, A2), VectorMultiply(Two, A3));
+		const VectorRegister4Double H11 = VectorSubtract(A3, A2);
+
+		for (int32 nAxis = 0; nAxis < 3; ++nAxis)
+		{
+			VectorRegister4Double Value = VectorMultiply(H00, VectorLoadAligned(P0[nAxis]));
+			Value = VectorMultiplyAdd(H10, VectorLoadAligned(T0[nAxis]), Value);
+			Value = VectorMultiplyAdd(H01, VectorLoadAligned(P1[nAxis]), Value);
+			Value = VectorMultiplyAdd(H11, VectorLoadAligned(T1[nAxis]), Value);
+			VectorStoreAligned(Value, Values[nAxis]);
+		}
+
+		if (OutDerivatives)
+		{
+			// Derivative basis of FMath::CubicInterpDerivative, divided by the segment length like FInterpCurve::EvalDerivative
+			const VectorRegister4Double D = VectorLoadAligned(InvDiff);
+			const VectorRegister4Double D00 = VectorMultiply(VectorSubtract(VectorMultiply(Six, A2), VectorMultiply(Six, A)), D);
+			const VectorRegister4Double D10 = VectorMultiply(VectorAdd(VectorSubtract(VectorMultiply(Three, A2), VectorMultiply(Four, A)), One), D);
+			const VectorRegister4Double D01 = VectorMultiply(VectorSubtract(VectorMultiply(Six, A), VectorMultiply(Six, A2)), D);
+			const VectorRegister4Double D11 = VectorMultiply(VectorSubtract(VectorMultiply(Three, A2), VectorMultiply(Two, A)), D);
+
+			for (int32 nAxis = 0; nAxis < 3; ++nAxis)
+			{
+				VectorRegister4Double Derivative = VectorMultiply(D00, VectorLoadAligned(P0[nAxis]));
+				Derivative = VectorMultiplyAdd(D10, VectorLoadAligned(T0[nAxis]), Derivative);
+				Derivative = VectorMultiplyAdd(D01, VectorLoadAligned(P1[nAxis]), Derivative);
+				Derivative = VectorMultiplyAdd(D11, VectorLoadAligned(T1[nAxis]), Derivative);
+				VectorStoreAligned(Derivative, Derivatives[nAxis]);
+			}
+		}
+
+		for (int32 nLane = 0; nLane < NumLanes; ++nLane)
+		{
+			OutValues[Lanes[nLane]] = FVector(Values[0][nLane], Values[1][nLane], Values[2][nLane]);
+			if (OutDerivatives)
+			{
+				(*OutDerivatives)[Lanes[nLane]] = FVector(Derivatives[0][nLane], Derivatives[1][nLane], Derivatives[2][nLane]);
+			}
+		}
+		NumLanes = 0;
+	};
+
+	FCurveCursor Cursor;
+	for (int32 nKey = 0; nKey < NumKeys; ++nKey)
+	{
+		const float Key = InputKeys[nKey];
+		float SegmentAlpha;
+		float Diff;
+
+		// Linear and constant segments are rare on splines, they go through the curve itself
+		if (!Cursor.Seek(Curve, Key, SegmentAlpha, Diff) || Curve.Points[Cursor.Index].InterpMode == CIM_Linear || Curve.Points[Cursor.Index].InterpMode == CIM_Constant)
+		{
+			OutValues[nKey] = Curve.Eval(Key, Default);
+			if (OutDerivatives)
+			{
+				(*OutDerivatives)[nKey] = Curve.EvalDerivative(Key, FVector::ZeroVector);
+			}
+			continue;
+		}
+
+		const FInterpCurvePoint<FVector>& Prev = Curve.Points[Cursor.Index];
+		const FInterpCurvePoint<FVector>& Next = Curve.Points[Cursor.Index + 1];
+		const FVector StartTangent = Prev.LeaveTangent * Diff;
+		const FVector EndTangent = Next.ArriveTangent * Diff;
+
+		Alpha[NumLanes] = SegmentAlpha;
+		InvDiff[NumLanes] = 1.0 / Diff;
+		for (int32 nAxis = 0; nAxis < 3; ++nAxis)
+		{
+			P0[nAxis][NumLanes] = Prev.OutVal[nAxis];
+			T0[nAxis][NumLanes] = StartTangent[nAxis];
+			P1[nAxis][NumLanes] = Next.OutVal[nAxis];
+			T1[nAxis][NumLanes] = EndTangent[nAxis];
+		}
+		Lanes[NumLanes] = nKey;
+
+		if (++NumLanes == LaneCount)
+		{
+			FlushLanes();
+		}
+	}
+
+	FlushLanes();
+}
@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SplineMeshInstancing.h"
+
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Components/SplineMeshComponent.h"
+
+FTransform FSplineMeshInstancePacker::PackSegment(const FSplineMeshParams& Params, const FBox& MeshBounds, TArrayView<float> OutCustomData)
+{
+	check(OutCustomData.Num() >= NumCustomDataFloats);
+
+	// Custom data is float, keeping positions relative to the instance keeps them precise far from the origin
+	const FVector Origin = (Params.StartPos + Params.EndPos) * 0.5f;
+	const FVector StartPos = Params.StartPos - Origin;
+	const FVector EndPos = Params.EndPos - Origin;
+	const double MeshLength = MeshBounds.Max.X - MeshBounds.Min.X;
+
+	float* Data = OutCustomData.GetData();
+	auto PackVector = [&Data](const FVector& Value)
+	{
+		*Data++ = Value.X;
+		*Data++ = Value.Y;
+		*Data++ = Value.Z;
+	};
+	auto PackVector2D = [&Data](const FVector2D& Value)
+	{
+		*Data++ = Value.X;
+		*Data++ = Value.Y;
+	};
+
+	PackVector(StartPos);
+	PackVector(Params.StartTangent);
+	PackVector(EndPos);
+	PackVector(Params.EndTangent);
+	PackVector2D(Params.StartScale);
+	PackVector2D(Params.EndScale);
+	*Data++ = Params.StartRoll;
+	*Data++ = Params.EndRoll;
+	PackVector2D(Params.StartOffset);
+	PackVector2D(Params.EndOffset);
+	*Data++ = MeshBounds.Min.X;
+	*Data++ = MeshLength > UE_KINDA_SMALL_NUMBER ? 1.0 / MeshLength : 0.0;
+
+	return FTransform(Origin);
+}
+
+void FSplineMeshInstancePacker::PackSegments(TConstArrayView<FSplineMeshParams> Segments, const FBox& MeshBounds, FPackedSegments& OutPacked)
+{
+	OutPacked.Transforms.SetNumUninitialized(Segments.Num());
+	OutPacked.CustomData.SetNumUninitialized(Segments.Num() * NumCustomDataFloats);
+	OutPacked.BoundsScale = 1.0f;
+
+	for (int32 nSegment = 0; nSegment < Segments.Num(); ++nSegment)
+	{
+		const TArrayView<float> CustomData(OutPacked.CustomData.GetData() + nSegment * NumCustomDataFloats, NumCustomDataFloats);
+		OutPacked.Transforms[nSegment] = PackSegment(Segments[nSegment], MeshBounds, CustomData);
+		OutPacked.BoundsScale = FMath::Max(OutPacked.BoundsScale, ComputeBoundsScale(CustomData, MeshBounds));
+	}
+}
+
+FVector FSplineMeshInstancePacker::DeformPosition(TConstArrayView<float> CustomData, const FVector& MeshPosition)
+{
+	check(CustomData.Num() >= NumCustomDataFloats);
+
+	const float* Data = CustomData.GetData();
+	const FVector StartPos(Data[0], Data[1], Data[2]);
+	const FVector StartTangent(Data[3], Data[4], Data[5]);
+	const FVector EndPos(Data[6], Data[7], Data[8]);
+	const FVector EndTangent(Data[9], Data[10], Data[11]);
+	const FVector2D StartScale(Data[12], Data[13]);
+	const FVector2D EndScale(Data[14], Data[15]);
+	const float StartRoll = Data[16];
+	const float EndRoll = Data[17];
+	const FVector2D StartOffset(Data[18], Data[19]);
+	const FVector2D EndOffset(Data[20], Data[21]);
+	const float Alpha = (MeshPosition.X - Data[22]) * Data[23];
+
+	// Same slice as USplineMeshComponent::CalcSliceTransformAtSplineOffset without smooth roll and scale interpolation
+	const FVector SplinePos = FMath::CubicInterp(StartPos, StartTangent, EndPos, EndTangent, Alpha);
+	const FVector SplineDir = FMath::CubicInterpDerivative(StartPos, StartTangent, EndPos, EndTangent, Alpha).GetSafeNormal();
+
+	const FVector BaseXVec = (FVector::UpVector ^ SplineDir).GetSafeNormal();
+	const FVector BaseYVec = (SplineDir ^ BaseXVec).GetSafeNormal();
+
+	const FVector2D SliceOffset = FMath::Lerp(StartOffset, EndOffset, Alpha);
+	const float Roll = FMath::Lerp(StartRoll, EndRoll, Alpha);
+	const FVector2D Scale = FMath::Lerp(StartScale, EndScale, Alpha);
+
+	float SinAngle;
+	float CosAngle;
+	FMath::SinCos(&SinAngle, &CosAngle, Roll);
+	const FVector XVec = CosAngle * BaseXVec - SinAngle * BaseYVec;
+	const FVector YVec = CosAngle * BaseYVec + SinAngle * BaseXVec;
+
+	return SplinePos + SliceOffset.X * BaseXVec + SliceOffset.Y * BaseYVec
+		+ XVec * (MeshPosition.Y * Scale.X) + YVec * (MeshPosition.Z * Scale.Y);
+}
+
+FSplineMeshInstancePacker::FStats FSplineMeshInstancePacker::ComputeStats(int32 NumSegments, int32 NumMeshSections)
+{
+	FStats Stats;
+	Stats.NumSegments = NumSegments;
+	Stats.ComponentDrawCalls = NumSegments * NumMeshSections;
+	Stats.InstancedDrawCalls = NumSegments > 0 ? NumMeshSections : 0;
+	Stats.ComponentBytes = static_cast<int64>(NumSegments) * sizeof(USplineMeshComponent);
+	Stats.InstancedBytes = NumSegments > 0
+		? sizeof(UInstancedStaticMeshComponent) + static_cast<int64>(NumSegments) * (sizeof(FInstancedStaticMeshInstanceData) + NumCustomDataFloats * sizeof(float))
+		: 0;
+	return Stats;
+}
+
+float FSplineMeshInstancePacker::ComputeBoundsScale(TConstArrayView<float> CustomData, const FBox& MeshBounds)
+{
+	const FVector Center = MeshBounds.GetCenter();
+	const FVector Extent = MeshBounds.GetExtent().ComponentMax(FVector(1.0f));
+	float Scale = 1.0f;
+
+	// Corners of evenly spaced cross sections, the curve can't bulge much between them at the segment lengths generated here
+	for (int32 nSlice = 0; nSlice <= BoundsSlices; ++nSlice)
+	{
+		const float X = FMath::Lerp(MeshBounds.Min.X, MeshBounds.Max.X, static_cast<float>(nSlice) / BoundsSlices);
+		for (int32 nCorner = 0; nCorner < 4; ++nCorner)
+		{
+			const FVector Corner(X, nCorner & 1 ? MeshBounds.Max.Y : MeshBounds.Min.Y, nCorner & 2 ? MeshBounds.Max.Z : MeshBounds.Min.Z);
+			const FVector Distance = (DeformPosition(CustomData, Corner) - Center).GetAbs();
+			Scale = FMath::Max(Scale, (Distance / Extent).GetMax());
+		}
+	}
+
+	return Scale;
+}
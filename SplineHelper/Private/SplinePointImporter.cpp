@@ -0,0 +1,308 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SplinePointImporter.h"
+
+#include "SplineHelperLog.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+
+FStreamingPolylineSimplifier::FStreamingPolylineSimplifier(float InTolerance, TFunction<void(const FVector&)> InEmitPoint)
+	: ToleranceSquared(FMath::Square(FMath::Max(InTolerance, 0.0f)))
+	, EmitPoint(MoveTemp(InEmitPoint))
+{
+	Window.Reserve(MaxWindowSize);
+}
+
+void FStreamingPolylineSimplifier::AddPoint(const FVector& Point)
+{
+	++NumPointsRead;
+
+	if (!bHasAnchor)
+	{
+		Emit(Point);
+		return;
+	}
+
+	const FVector& Previous = Window.IsEmpty() ? Anchor : Window.Last();
+	if (Previous.Equals(Point, UE_KINDA_SMALL_NUMBER))
+	{
+		return;
+	}
+
+	if (Window.Num() >= MaxWindowSize || !IsWindowWithinTolerance(Point))
+	{
+		const FVector NewAnchor = Window.Last();
+		Window.Reset();
+		Emit(NewAnchor);
+	}
+
+	Window.Add(Point);
+}
+
+void FStreamingPolylineSimplifier::Finish()
+{
+	if (!Window.IsEmpty())
+	{
+		const FVector LastPoint = Window.Last();
+		Window.Reset();
+		Emit(LastPoint);
+	}
+}
+
+void FStreamingPolylineSimplifier::Emit(const FVector& Point)
+{
+	Anchor = Point;
+	bHasAnchor = true;
+	++NumPointsEmitted;
+	EmitPoint(Point);
+}
+
+bool FStreamingPolylineSimplifier::IsWindowWithinTolerance(const FVector& Candidate) const
+{
+	for (const FVector& WindowPoint : Window)
+	{
+		if (FMath::PointDistToSegmentSquared(WindowPoint, Anchor, Candidate) > ToleranceSquared)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FSplinePointImporter::ImportFile(const FString& FilePath, TFunctionRef<void(const FVector&)> OnPoint)
+{
+	enum class EFormat : uint8
+	{
+		Unknown,
+		Text,
+		Binary
+	};
+
+	EFormat Format = EFormat::Unknown;
+	// Bytes left over from the previous chunk: a partial line for text, a partial triple or header for binary
+	TArray<uint8> Pending;
+	bool bValid = true;
+
+	const bool bRead = ReadChunks(FilePath, [&](const uint8* Data, int64 Size)
+	{
+		int64 Offset = 0;
+
+		if (Format == EFormat::Unknown)
+		{
+			const int64 HeaderSize = sizeof(uint32) * 2;
+			const int64 Missing = HeaderSize - Pending.Num();
+			const int64 ToCopy = FMath::Min(Missing, Size);
+			Pending.Append(Data, ToCopy);
+			Offset = ToCopy;
+
+			if (Pending.Num() < HeaderSize)
+			{
+				return true;
+			}
+
+			uint32 Magic = 0;
+			uint32 Version = 0;
+			FMemory::Memcpy(&Magic, Pending.GetData(), sizeof(uint32));
+			FMemory::Memcpy(&Version, Pending.GetData() + sizeof(uint32), sizeof(uint32));
+
+			if (Magic == BinaryMagic)
+			{
+				if (Version != BinaryVersion)
+				{
+					UE_LOG(LogSplineHelper, Error, TEXT("Unsupported point file version %u in %s"), Version, *FilePath);
+					bValid = false;
+					return false;
+				}
+				Format = EFormat::Binary;
+				Pending.Reset();
+			}
+			else
+			{
+				// Re-read the sniffed bytes as part of the first line
+				Format = EFormat::Text;
+				Offset -= ToCopy;
+				Pending.SetNum(Pending.Num() - ToCopy);
+			}
+		}
+
+		if (Format == EFormat::Binary)
+		{
+			constexpr int64 TripleSize = sizeof(float) * 3;
+			float Triple[3];
+
+			if (Pending.Num() > 0)
+			{
+				const int64 ToCopy = FMath::Min(TripleSize - Pending.Num(), Size - Offset);
+				Pending.Append(Data + Offset, ToCopy);
+				Offset += ToCopy;
+
+				if (Pending.Num() < TripleSize)
+				{
+					return true;
+				}
+
+				FMemory::Memcpy(Triple, Pending.GetData(), TripleSize);
+				OnPoint(FVector(Triple[0], Triple[1], Triple[2]));
+				Pending.Reset();
+			}
+
+			for (; Offset + TripleSize <= Size; Offset += TripleSize)
+			{
+				FMemory::Memcpy(Triple, Data + Offset, TripleSize);
+				OnPoint(FVector(Triple[0], Triple[1], Triple[2]));
+			}
+
+			Pending.Append(Data + Offset, Size - Offset);
+			return true;
+		}
+
+		int64 LineStart = Offset;
+		for (int64 Index = Offset; Index < Size; ++Index)
+		{
+			if (Data[Index] != '\n')
+			{
+				continue;
+			}
+
+			FVector Point;
+			if (Pending.Num() > 0)
+			{
+				Pending.Append(Data + LineStart, Index - LineStart);
+				if (ParseTextLine(reinterpret_cast<const ANSICHAR*>(Pending.GetData()), Pending.Num(), Point))
+				{
+					OnPoint(Point);
+				}
+				Pending.Reset();
+			}
+			else if (ParseTextLine(reinterpret_cast<const ANSICHAR*>(Data + LineStart), Index - LineStart, Point))
+			{
+				OnPoint(Point);
+			}
+			LineStart = Index + 1;
+		}
+
+		Pending.Append(Data + LineStart, Size - LineStart);
+		return true;
+	});
+
+	if (!bRead || !bValid)
+	{
+		return false;
+	}
+
+	if (Format != EFormat::Binary && Pending.Num() > 0)
+	{
+		FVector Point;
+		if (ParseTextLine(reinterpret_cast<const ANSICHAR*>(Pending.GetData()), Pending.Num(), Point))
+		{
+			OnPoint(Point);
+		}
+	}
+	else if (Format == EFormat::Binary && Pending.Num() > 0)
+	{
+		UE_LOG(LogSplineHelper, Warning, TEXT("Ignoring %d trailing bytes in %s"), Pending.Num(), *FilePath);
+	}
+
+	return true;
+}
+
+bool FSplinePointImporter::ReadChunks(const FString& FilePath, TFunctionRef<bool(const uint8*, int64)> OnChunk)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	if (TUniquePtr<IMappedFileHandle> MappedFile = TUniquePtr<IMappedFileHandle>(PlatformFile.OpenMapped(*FilePath)))
+	{
+		const int64 FileSize = MappedFile->GetFileSize();
+		for (int64 Offset = 0; Offset < FileSize; Offset += ChunkSize)
+		{
+			const int64 RegionSize = FMath::Min(ChunkSize, FileSize - Offset);
+			TUniquePtr<IMappedFileRegion> Region = TUniquePtr<IMappedFileRegion>(MappedFile->MapRegion(Offset, RegionSize));
+			if (!Region.IsValid())
+			{
+				UE_LOG(LogSplineHelper, Error, TEXT("Failed to map %s at offset %lld"), *FilePath, Offset);
+				return false;
+			}
+
+			if (!OnChunk(Region->GetMappedPtr(), Region->GetMappedSize()))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	TUniquePtr<IFileHandle> FileHandle = TUniquePtr<IFileHandle>(PlatformFile.OpenRead(*FilePath));
+	if (!FileHandle.IsValid())
+	{
+		UE_LOG(LogSplineHelper, Error, TEXT("Failed to open point file %s"), *FilePath);
+		return false;
+	}
+
+	TArray<uint8> Buffer;
+	Buffer.SetNumUninitialized(ChunkSize);
+
+	const int64 FileSize = FileHandle->Size();
+	for (int64 Offset = 0; Offset < FileSize; Offset += ChunkSize)
+	{
+		const int64 ReadSize = FMath::Min(ChunkSize, FileSize - Offset);
+		if (!FileHandle->Read(Buffer.GetData(), ReadSize))
+		{
+			UE_LOG(LogSplineHelper, Error, TEXT("Failed to read %s at offset %lld"), *FilePath, Offset);
+			return false;
+		}
+
+		if (!OnChunk(Buffer.GetData(), ReadSize))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FSplinePointImporter::ParseTextLine(const ANSICHAR* Line, int32 Length, FVector& OutPoint)
+{
+	auto IsSeparator = [](ANSICHAR Char)
+	{
+		return Char == ',' || Char == ';' || Char == ' ' || Char == '\t' || Char == '\r';
+	};
+
+	auto IsNumberChar = [](ANSICHAR Char)
+	{
+		return FCharAnsi::IsDigit(Char) || Char == '-' || Char == '+' || Char == '.' || Char == 'e' || Char == 'E';
+	};
+
+	double Values[3];
+	int32 NumValues = 0;
+	int32 Index = 0;
+
+	while (NumValues < 3)
+	{
+		while (Index < Length && IsSeparator(Line[Index]))
+		{
+			++Index;
+		}
+
+		ANSICHAR Token[64];
+		int32 TokenLength = 0;
+		while (Index < Length && !IsSeparator(Line[Index]))
+		{
+			if (!IsNumberChar(Line[Index]) || TokenLength >= UE_ARRAY_COUNT(Token) - 1)
+			{
+				return false;
+			}
+			Token[TokenLength++] = Line[Index++];
+		}
+
+		if (TokenLength == 0)
+		{
+			return false;
+		}
+
+		Token[TokenLength] = '\0';
+		Values[NumValues++] = FCStringAnsi::Atod(Token);
+	}
+
+	OutPoint = FVector(Values[0], Values[1], Values[2]);
+	return true;
+}
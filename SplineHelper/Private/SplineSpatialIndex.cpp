@@ -0,0 +1,452 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SplineSpatialIndex.h"
+
+#include "Algo/Sort.h"
+#include "Components/SplineComponent.h"
+
+void FSplineSpatialIndex::Reset()
+{
+	SegmentsById.Reset();
+	PropSlotsById.Reset();
+	KeyOffset = 0.0f;
+	SegmentIdsByKey.Reset();
+	UnsampledSegments.Reset();
+	Samples.Reset();
+	SampleBounds.Reset();
+	NumRemovedSamples = 0;
+	Props.Reset();
+	PropBounds.Reset();
+	UnindexedProps.Reset();
+	NumRemovedProps = 0;
+	SampleHierarchies.Reset();
+	PropHierarchies.Reset();
+	bBuilt = false;
+}
+
+void FSplineSpatialIndex::AddSegment(int32 SegmentIndex, float StartKey, float EndKey)
+{
+	RemoveSegment(SegmentIndex);
+
+	const FSegment Segment{ StartKey - KeyOffset, EndKey - KeyOffset, SegmentIndex };
+	SegmentsById.Add(SegmentIndex, Segment);
+	for (int32 Bucket = GetKeyBucket(Segment.StartKey); Bucket <= GetKeyBucket(Segment.EndKey); ++Bucket)
+	{
+		SegmentIdsByKey.FindOrAdd(Bucket).Add(SegmentIndex);
+	}
+	UnsampledSegments.Add(SegmentIndex);
+	bBuilt = false;
+}
+
+void FSplineSpatialIndex::RemoveSegment(int32 SegmentIndex)
+{
+	FSegment Segment;
+	if (!SegmentsById.RemoveAndCopyValue(SegmentIndex, Segment))
+	{
+		return;
+	}
+
+	for (int32 Bucket = GetKeyBucket(Segment.StartKey); Bucket <= GetKeyBucket(Segment.EndKey); ++Bucket)
+	{
+		TArray<int32, TInlineAllocator<2>>* SegmentIds = SegmentIdsByKey.Find(Bucket);
+		if (SegmentIds)
+		{
+			SegmentIds->RemoveSingleSwap(SegmentIndex, false);
+			if (SegmentIds->IsEmpty())
+			{
+				SegmentIdsByKey.Remove(Bucket);
+			}
+		}
+	}
+
+	// Samples stay in the hierarchies until the next compaction, queries skip them
+	if (Segment.FirstSample != INDEX_NONE)
+	{
+		for (int32 nSample = Segment.FirstSample; nSample < Segment.FirstSample + SamplesPerSegment; ++nSample)
+		{
+			Samples[nSample].SegmentIndex = INDEX_NONE;
+		}
+		NumRemovedSamples += SamplesPerSegment;
+	}
+}
+
+void FSplineSpatialIndex::AddProp(int32 PropIndex, const FVector& Location)
+{
+	RemoveProp(PropIndex);
+
+	const int32 Slot = Props.Add({ Location, PropIndex });
+	PropBounds.Add(FBox(Location, Location));
+	PropSlotsById.Add(PropIndex, Slot);
+	UnindexedProps.Add(Slot);
+	bBuilt = false;
+}
+
+void FSplineSpatialIndex::RemoveProp(int32 PropIndex)
+{
+	int32 Slot;
+	if (PropSlotsById.RemoveAndCopyValue(PropIndex, Slot))
+	{
+		Props[Slot].PropIndex = INDEX_NONE;
+		++NumRemovedProps;
+	}
+}
+
+void FSplineSpatialIndex::ShiftKeys(float Delta)
+{
+	// Sampled locations don't move, only the keys they are reported with
+	KeyOffset += Delta;
+}
+
+void FSplineSpatialIndex::Build(const USplineComponent* Spline)
+{
+	TArray<int32> NewSamples;
+	for (const int32 SegmentIndex : UnsampledSegments)
+	{
+		FSegment* Segment = SegmentsById.Find(SegmentIndex);
+		if (Segment && Segment->FirstSample == INDEX_NONE)
+		{
+			SampleSegment(Spline, *Segment, NewSamples);
+		}
+	}
+	UnsampledSegments.Reset();
+
+	if (NumRemovedSamples * 2 > Samples.Num())
+	{
+		CompactSamples();
+	}
+	else if (NewSamples.Num() > 0)
+	{
+		FHierarchy::Insert(SampleHierarchies, SampleBounds, MoveTemp(NewSamples), [this](int32 Item) { return Samples[Item].SegmentIndex != INDEX_NONE; });
+	}
+
+	if (NumRemovedProps * 2 > Props.Num())
+	{
+		CompactProps();
+	}
+	else if (UnindexedProps.Num() > 0)
+	{
+		FHierarchy::Insert(PropHierarchies, PropBounds, MoveTemp(UnindexedProps), [this](int32 Item) { return Props[Item].PropIndex != INDEX_NONE; });
+	}
+	UnindexedProps.Reset();
+
+	bBuilt = true;
+}
+
+void FSplineSpatialIndex::SampleSegment(const USplineComponent* Spline, FSegment& Segment, TArray<int32>& OutNewSamples)
+{
+	Segment.FirstSample = Samples.Num();
+
+	float PreviousKey = Segment.StartKey;
+	FVector PreviousLocation = Spline->GetLocationAtSplineInputKey(PreviousKey + KeyOffset, ESplineCoordinateSpace::Local);
+
+	for (int32 nSample = 1; nSample <= SamplesPerSegment; ++nSample)
+	{
+		const float Key = FMath::Lerp(Segment.StartKey, Segment.EndKey, static_cast<float>(nSample) / SamplesPerSegment);
+		const FVector Location = Spline->GetLocationAtSplineInputKey(Key + KeyOffset, ESplineCoordinateSpace::Local);
+
+		OutNewSamples.Add(Samples.Add({ PreviousLocation, Location, PreviousKey, Key, Segment.SegmentIndex }));
+
+		FBox& Bounds = SampleBounds.Add_GetRef(FBox(ForceInit));
+		Bounds += PreviousLocation;
+		Bounds += Location;
+
+		PreviousKey = Key;
+		PreviousLocation = Location;
+	}
+}
+
+void FSplineSpatialIndex::CompactSamples()
+{
+	TArray<FSample> OldSamples = MoveTemp(Samples);
+	TArray<FBox> OldSampleBounds = MoveTemp(SampleBounds);
+	Samples.Reset(SegmentsById.Num() * SamplesPerSegment);
+	SampleBounds.Reset(SegmentsById.Num() * SamplesPerSegment);
+
+	TArray<FSegment*> SortedSegments;
+	SortedSegments.Reserve(SegmentsById.Num());
+	for (TPair<int32, FSegment>& Pair : SegmentsById)
+	{
+		if (Pair.Value.FirstSample != INDEX_NONE)
+		{
+			SortedSegments.Add(&Pair.Value);
+		}
+	}
+
+	// Sorted order keeps samples that are close along the spline close in memory
+	Algo::Sort(SortedSegments, [](const FSegment* A, const FSegment* B) { return A->StartKey < B->StartKey; });
+
+	for (FSegment* Segment : SortedSegments)
+	{
+		const int32 FirstSample = Samples.Num();
+		Samples.Append(OldSamples.GetData() + Segment->FirstSample, SamplesPerSegment);
+		SampleBounds.Append(OldSampleBounds.GetData() + Segment->FirstSample, SamplesPerSegment);
+		Segment->FirstSample = FirstSample;
+	}
+	NumRemovedSamples = 0;
+
+	TArray<int32> Items;
+	Items.Reserve(Samples.Num());
+	for (int32 nSample = 0; nSample < Samples.Num(); ++nSample)
+	{
+		Items.Add(nSample);
+	}
+
+	SampleHierarchies.Reset();
+	if (Items.Num() > 0)
+	{
+		SampleHierarchies.AddDefaulted_GetRef().Build(SampleBounds, MoveTemp(Items));
+	}
+}
+
+void FSplineSpatialIndex::CompactProps()
+{
+	TArray<FProp> OldProps = MoveTemp(Props);
+	Props.Reset(PropSlotsById.Num());
+	PropBounds.Reset(PropSlotsById.Num());
+
+	TArray<int32> Items;
+	Items.Reserve(PropSlotsById.Num());
+	for (const FProp& Prop : OldProps)
+	{
+		if (Prop.PropIndex != INDEX_NONE)
+		{
+			const int32 Slot = Props.Add(Prop);
+			PropBounds.Add(FBox(Prop.Location, Prop.Location));
+			PropSlotsById.FindChecked(Prop.PropIndex) = Slot;
+			Items.Add(Slot);
+		}
+	}
+	NumRemovedProps = 0;
+
+	PropHierarchies.Reset();
+	if (Items.Num() > 0)
+	{
+		PropHierarchies.AddDefaulted_GetRef().Build(PropBounds, MoveTemp(Items));
+	}
+}
+
+void FSplineSpatialIndex::FHierarchy::Build(const TArray<FBox>& ItemBounds, TArray<int32>&& InItems)
+{
+	Nodes.Reset();
+	Items = MoveTemp(InItems);
+
+	if (Items.Num() > 0)
+	{
+		Nodes.AddDefaulted();
+		BuildNode(ItemBounds, 0, 0, Items.Num());
+	}
+}
+
+void FSplineSpatialIndex::FHierarchy::Insert(TArray<FHierarchy>& Hierarchies, const TArray<FBox>& ItemBounds, TArray<int32>&& NewItems, TFunctionRef<bool(int32)> IsAlive)
+{
+	NewItems.RemoveAll([&IsAlive](int32 Item) { return !IsAlive(Item); });
+
+	while (Hierarchies.Num() > 0 && Hierarchies.Last().Items.Num() <= NewItems.Num())
+	{
+		for (const int32 Item : Hierarchies.Last().Items)
+		{
+			if (IsAlive(Item))
+			{
+				NewItems.Add(Item);
+			}
+		}
+		Hierarchies.Pop();
+	}
+
+	if (NewItems.Num() > 0)
+	{
+		Hierarchies.AddDefaulted_GetRef().Build(ItemBounds, MoveTemp(NewItems));
+	}
+}
+
+void FSplineSpatialIndex::FHierarchy::BuildNode(const TArray<FBox>& ItemBounds, int32 NodeIndex, int32 Begin, int32 End)
+{
+	FBox Bounds(ForceInit);
+	FBox CentroidBounds(ForceInit);
+	for (int32 nItem = Begin; nItem < End; ++nItem)
+	{
+		const FBox& Item = ItemBounds[Items[nItem]];
+		Bounds += Item;
+		CentroidBounds += Item.GetCenter();
+	}
+
+	Nodes[NodeIndex].Bounds = Bounds;
+
+	if (End - Begin <= MaxLeafSize)
+	{
+		Nodes[NodeIndex].First = Begin;
+		Nodes[NodeIndex].Count = End - Begin;
+		return;
+	}
+
+	const FVector Extent = CentroidBounds.GetExtent();
+	const int32 Axis = Extent.X >= Extent.Y && Extent.X >= Extent.Z ? 0 : (Extent.Y >= Extent.Z ? 1 : 2);
+
+	Algo::Sort(MakeArrayView(Items.GetData() + Begin, End - Begin), [&ItemBounds, Axis](int32 A, int32 B)
+	{
+		return ItemBounds[A].GetCenter()[Axis] < ItemBounds[B].GetCenter()[Axis];
+	});
+
+	const int32 Middle = (Begin + End) / 2;
+	const int32 FirstChild = Nodes.AddDefaulted(2);
+	Nodes[NodeIndex].First = FirstChild;
+	Nodes[NodeIndex].Count = 0;
+
+	BuildNode(ItemBounds, FirstChild, Begin, Middle);
+	BuildNode(ItemBounds, FirstChild + 1, Middle, End);
+}
+
+bool FSplineSpatialIndex::FindClosestPoint(const USplineComponent* Spline, const FVector& Location, FClosestPointResult& OutResult) const
+{
+	int32 BestSample = INDEX_NONE;
+	double BestDistanceSquared = TNumericLimits<double>::Max();
+
+	TArray<int32, TInlineAllocator<64>> Stack;
+
+	// The best distance carries over, so later hierarchies are mostly pruned at their root
+	for (const FHierarchy& Hierarchy : SampleHierarchies)
+	{
+		const TArray<FNode>& Nodes = Hierarchy.Nodes;
+		Stack.Push(0);
+
+		while (Stack.Num() > 0)
+		{
+			const FNode& Node = Nodes[Stack.Pop()];
+			if (Node.Bounds.ComputeSquaredDistanceToPoint(Location) >= BestDistanceSquared)
+			{
+				continue;
+			}
+
+			if (Node.Count > 0)
+			{
+				for (int32 nItem = Node.First; nItem < Node.First + Node.Count; ++nItem)
+				{
+					const int32 SampleIndex = Hierarchy.Items[nItem];
+					const FSample& Sample = Samples[SampleIndex];
+					if (Sample.SegmentIndex == INDEX_NONE)
+					{
+						continue;
+					}
+
+					const double DistanceSquared = FVector::DistSquared(FMath::ClosestPointOnSegment(Location, Sample.Start, Sample.End), Location);
+					if (DistanceSquared < BestDistanceSquared)
+					{
+						BestDistanceSquared = DistanceSquared;
+						BestSample = SampleIndex;
+					}
+				}
+				continue;
+			}
+
+			// Visit the nearer child first so the farther one is more likely to get pruned
+			const int32 Near = Node.First;
+			const int32 Far = Node.First + 1;
+			if (Nodes[Near].Bounds.ComputeSquaredDistanceToPoint(Location) <= Nodes[Far].Bounds.ComputeSquaredDistanceToPoint(Location))
+			{
+				Stack.Push(Far);
+				Stack.Push(Near);
+			}
+			else
+			{
+				Stack.Push(Near);
+				Stack.Push(Far);
+			}
+		}
+	}
+
+	if (BestSample == INDEX_NONE)
+	{
+		return false;
+	}
+
+	// Golden section search on the curve itself, the samples are only a chordal approximation
+	const FSample& Sample = Samples[BestSample];
+	constexpr float InvPhi = 0.618034f;
+	float Low = Sample.StartKey + KeyOffset;
+	float High = Sample.EndKey + KeyOffset;
+
+	for (int32 nIteration = 0; nIteration < RefineIterations; ++nIteration)
+	{
+		const float A = High - (High - Low) * InvPhi;
+		const float B = Low + (High - Low) * InvPhi;
+		const double DistanceA = FVector::DistSquared(Spline->GetLocationAtSplineInputKey(A, ESplineCoordinateSpace::Local), Location);
+		const double DistanceB = FVector::DistSquared(Spline->GetLocationAtSplineInputKey(B, ESplineCoordinateSpace::Local), Location);
+
+		if (DistanceA < DistanceB)
+		{
+			High = B;
+		}
+		else
+		{
+			Low = A;
+		}
+	}
+
+	OutResult.InputKey = (Low + High) * 0.5f;
+	OutResult.Location = Spline->GetLocationAtSplineInputKey(OutResult.InputKey, ESplineCoordinateSpace::Local);
+	OutResult.SegmentIndex = Sample.SegmentIndex;
+	return true;
+}
+
+int32 FSplineSpatialIndex::FindSegmentAtInputKey(float InputKey) const
+{
+	const float StoredKey = InputKey - KeyOffset;
+	const TArray<int32, TInlineAllocator<2>>* SegmentIds = SegmentIdsByKey.Find(GetKeyBucket(StoredKey));
+	if (!SegmentIds)
+	{
+		return INDEX_NONE;
+	}
+
+	// On a shared boundary the segment starting there wins
+	int32 BestSegment = INDEX_NONE;
+	float BestStartKey = -TNumericLimits<float>::Max();
+	for (const int32 SegmentIndex : *SegmentIds)
+	{
+		const FSegment& Segment = SegmentsById.FindChecked(SegmentIndex);
+		if (Segment.StartKey <= StoredKey && StoredKey <= Segment.EndKey && Segment.StartKey >= BestStartKey)
+		{
+			BestSegment = SegmentIndex;
+			BestStartKey = Segment.StartKey;
+		}
+	}
+	return BestSegment;
+}
+
+void FSplineSpatialIndex::FindPropsInRadius(const FVector& Location, float Radius, TArray<int32>& OutPropIndices) const
+{
+	const double RadiusSquared = FMath::Square(Radius);
+
+	TArray<int32, TInlineAllocator<64>> Stack;
+
+	for (const FHierarchy& Hierarchy : PropHierarchies)
+	{
+		const TArray<FNode>& Nodes = Hierarchy.Nodes;
+		Stack.Push(0);
+
+		while (Stack.Num() > 0)
+		{
+			const FNode& Node = Nodes[Stack.Pop()];
+			if (Node.Bounds.ComputeSquaredDistanceToPoint(Location) > RadiusSquared)
+			{
+				continue;
+			}
+
+			if (Node.Count > 0)
+			{
+				for (int32 nItem = Node.First; nItem < Node.First + Node.Count; ++nItem)
+				{
+					const FProp& Prop = Props[Hierarchy.Items[nItem]];
+					if (Prop.PropIndex != INDEX_NONE && FVector::DistSquared(Prop.Location, Location) <= RadiusSquared)
+					{
+						OutPropIndices.Add(Prop.PropIndex);
+					}
+				}
+				continue;
+			}
+
+			Stack.Push(Node.First);
+			Stack.Push(Node.First + 1);
+		}
+	}
+}
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SplineMeshInstancing.h"
+
+#include "Components/SplineMeshComponent.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSplineMeshInstancingTest, "SplineHelper.SplineMeshInstancing",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FSplineMeshInstancingTest::RunTest(const FString& Parameters)
+{
+	// Mesh spans X like the engine's default meshes, the boundary makes the component use it without a static mesh
+	const FBox MeshBounds(FVector(-50.0, -20.0, -10.0), FVector(150.0, 20.0, 30.0));
+
+	USplineMeshComponent* Component = NewObject<USplineMeshComponent>();
+	Component->SetForwardAxis(ESplineMeshAxis::X, false);
+	Component->SplineBoundaryMin = MeshBounds.Min.X;
+	Component->SplineBoundaryMax = MeshBounds.Max.X;
+
+	FSplineMeshParams& Params = Component->SplineParams;
+	Params.StartPos = FVector(1000.0, -200.0, 50.0);
+	Params.StartTangent = FVector(400.0, 300.0, 0.0);
+	Params.EndPos = FVector(1300.0, 100.0, 120.0);
+	Params.EndTangent = FVector(100.0, 500.0, 80.0);
+	Params.StartScale = FVector2D(1.0, 1.5);
+	Params.EndScale = FVector2D(2.0, 0.5);
+	Params.StartRoll = 0.2f;
+	Params.EndRoll = -0.6f;
+	Params.StartOffset = FVector2D(10.0, -5.0);
+	Params.EndOffset = FVector2D(-20.0, 15.0);
+
+	float CustomData[FSplineMeshInstancePacker::NumCustomDataFloats];
+	const FTransform InstanceTransform = FSplineMeshInstancePacker::PackSegment(Params, MeshBounds, CustomData);
+
+	// The component zeroes the forward coordinate and moves the rest with the slice transform at it
+	const double Alphas[] = { 0.0, 0.25, 0.5, 0.8, 1.0 };
+	const FVector CrossSections[] = { FVector(0.0, 0.0, 0.0), FVector(0.0, 20.0, -10.0), FVector(0.0, -20.0, 30.0) };
+	for (const double Alpha : Alphas)
+	{
+		for (const FVector& CrossSection : CrossSections)
+		{
+			const FVector MeshPosition(FMath::Lerp(MeshBounds.Min.X, MeshBounds.Max.X, Alpha), CrossSection.Y, CrossSection.Z);
+			const FVector Expected = Component->CalcSliceTransform(MeshPosition.X).TransformPosition(CrossSection);
+			const FVector Packed = InstanceTransform.TransformPosition(FSplineMeshInstancePacker::DeformPosition(CustomData, MeshPosition));
+
+			TestTrue(FString::Printf(TEXT("DeformPosition matches CalcSliceTransform at %s (expected %s, got %s)"),
+				*MeshPosition.ToString(), *Expected.ToString(), *Packed.ToString()), Packed.Equals(Expected, 0.05));
+		}
+	}
+
+	const FSplineMeshInstancePacker::FStats EmptyStats = FSplineMeshInstancePacker::ComputeStats(0, 2);
+	TestEqual(TEXT("No segments draw nothing as components"), EmptyStats.ComponentDrawCalls, 0);
+	TestEqual(TEXT("No segments draw nothing instanced"), EmptyStats.InstancedDrawCalls, 0);
+	TestEqual(TEXT("No segments need no instanced memory"), EmptyStats.InstancedBytes, static_cast<int64>(0));
+
+	const FSplineMeshInstancePacker::FStats Stats = FSplineMeshInstancePacker::ComputeStats(100, 2);
+	TestEqual(TEXT("Components draw every section of every segment"), Stats.ComponentDrawCalls, 200);
+	TestEqual(TEXT("Instances draw every section once"), Stats.InstancedDrawCalls, 2);
+	TestTrue(TEXT("Instances need less memory than components"), Stats.InstancedBytes < Stats.ComponentBytes);
+
+	return true;
+}
+
+#endif
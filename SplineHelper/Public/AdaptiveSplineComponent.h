@@ -7,11 +7,32 @@
 #include "AdaptiveSplineComponent.generated.h"
 
 /**
- * This class is only used for subdivisions and simplifications
+ * This class is only used for subdivisions, simplifications and streamed point imports
  */
 UCLASS(meta = (BlueprintSpawnableComponent))
 class SPLINEHELPER_API UAdaptiveSplineComponent : public USplineComponent
 {
 	GENERATED_BODY()
-	
+
+public:
+	/**
+	 * Replaces the spline points with the points of a CSV or binary point file, the existing points are kept when the file can't be read.
+	 * The file is parsed in chunks and simplified while reading, points closer than Tolerance to the
+	 * simplified polyline are never added to the component.
+	 * Tolerance bounds the distance between the input and the simplified polyline, the curve through the kept points
+	 * can deviate further between them depending on the point types.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spline")
+	bool ImportPointsFromFile(const FString& FilePath, float Tolerance = 1.0f, ESplineCoordinateSpace::Type CoordinateSpace = ESplineCoordinateSpace::Local);
+
+	/** Removes the first NumPoints points, every curve is shifted once instead of once per point like RemoveSplinePoint does */
+	void RemoveFirstSplinePoints(int32 NumPoints, bool bUpdateSpline = true);
+
+	virtual void UpdateSpline() override;
+
+	/** Incremented every time the spline is rebuilt, lets caches skip work while the points are unchanged */
+	uint32 GetSplineRevision() const { return SplineRevision; }
+
+private:
+	uint32 SplineRevision = 0;
 };
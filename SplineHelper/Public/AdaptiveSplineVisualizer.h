@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ComponentVisualizer.h"
+#include "SplineComponentVisualizer.h"
+#include "UObject/ObjectKey.h"
+
+/** Proxy for a key drawn by the decimated visualizer */
+struct HAdaptiveSplineKeyProxy : public HComponentVisProxy
+{
+	DECLARE_HIT_PROXY();
+
+	HAdaptiveSplineKeyProxy(const UActorComponent* InComponent, int32 InKeyIndex)
+		: HComponentVisProxy(InComponent, HPP_Wireframe)
+		, KeyIndex(InKeyIndex)
+	{}
+
+	virtual EMouseCursor::Type GetMouseCursor() override
+	{
+		return EMouseCursor::CardinalCross;
+	}
+
+	int32 KeyIndex;
+};
+
+/**
+ * Spline visualizer for very dense adaptive splines.
+ * Falls back to the stock visualizer for small splines, otherwise draws a cached, screen size decimated line batch
+ * while keeping keys selectable for the subdivide / simplify tools.
+ */
+class FAdaptiveSplineVisualizer : public FSplineComponentVisualizer
+{
+public:
+	virtual void DrawVisualization(const UActorComponent* Component, const FSceneView* View, FPrimitiveDrawInterface* PDI) override;
+	virtual bool VisProxyHandleClick(FEditorViewportClient* InViewportClient, HComponentVisProxy* VisProxy, const FViewportClick& Click) override;
+
+private:
+	struct FCachedLineBatch
+	{
+		uint32 Revision = 0;
+		int32 KeyStride = 0;
+		FTransform ComponentTransform;
+		TArray<FVector> Points;
+		TArray<int32> Keys;
+	};
+
+	int32 ComputeKeyStride(const USplineComponent* SplineComp, const FSceneView* View) const;
+	void BuildLineBatch(const USplineComponent* SplineComp, int32 KeyStride, FCachedLineBatch& Batch) const;
+
+private:
+	/** Splines up to this many points are drawn by FSplineComponentVisualizer */
+	static constexpr int32 DecimationThreshold = 512;
+	static constexpr float PixelsPerSegment = 4.0f;
+	static constexpr float KeyPointSize = 8.0f;
+	static constexpr float SelectedKeyPointSize = 12.0f;
+	static constexpr int32 MaxCachedBatches = 64;
+
+	TMap<FObjectKey, FCachedLineBatch> CachedBatches;
+};
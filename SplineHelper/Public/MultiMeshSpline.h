@@ -4,11 +4,15 @@
 
 #include "CoreMinimal.h"
 #include "AdaptiveSplineComponent.h"
+#include "SplineSpatialIndex.h"
 #include "Components/SplineComponent.h"
 #include "GameFramework/Actor.h"
 #include "MultiMeshSpline.generated.h"
 
+class UInstancedStaticMeshComponent;
 class USplineMeshComponent;
+struct FSplineBatchSamples;
+struct FSplineMeshParams;
 
 USTRUCT(Blueprintable)
 struct FSplinedMeshRange
@@ -25,9 +29,15 @@ struct FSplinedMeshRange
 UENUM(Blueprintable)
 enum ESplineMeshType
 {
+	/** One segment between every two spline points */
 	Point,
 	TimeBased,
-	Steepness
+	Steepness,
+	/**
+	 * Fewest segments whose deformed mesh stays within DeformationTolerance of the spline (position, roll and scale).
+	 * Segments are searched in chunks of 16 spline points, so editing a point only changes the segments of its chunk.
+	 */
+	Deformation
 };
 
 
@@ -39,6 +49,73 @@ enum ERepetitionType
 	BetweenTimeIntervals
 };
 
+USTRUCT(Blueprintable)
+struct FSplineMeshLayer
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layer")
+	TObjectPtr<UStaticMesh> Mesh;
+
+	/** Offset of the mesh from the spline in the cross section, X is right and Y is up */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layer")
+	FVector2D Offset = FVector2D::ZeroVector;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layer")
+	TEnumAsByte<ESplineMeshType> SplineType;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layer", meta = (EditCondition = "SplineType == ESplineMeshType::TimeBased || SplineType == ESplineMeshType::Steepness", ClampMin = "0.001", UIMin = "0.001"))
+	float TimeInterval = 0.1;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layer", meta = (EditCondition = "SplineType == ESplineMeshType::Steepness", ClampMin = "0.5", UIMin = "0.5"))
+	float MaxSteepnessThreshold = 20;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layer", meta = (EditCondition = "SplineType == ESplineMeshType::Deformation", ClampMin = "0.01", UIMin = "0.01"))
+	float DeformationTolerance = 1.0f;
+
+	/**
+	 * Render every segment as an instance of one instanced static mesh, one draw per mesh section instead of one per segment.
+	 * Mesh materials have to bend the instances with Shaders/SplineMeshInstancing.ush, which moves positions only: normals
+	 * keep their undeformed direction, so shading of strongly bent segments differs from components. Instances are culled
+	 * against their undeformed bounds, the material must set Max World Position Offset Displacement to cover the bend.
+	 * Instanced segments have no collision and don't affect navigation, AppendTailPoints still generates components for them.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layer")
+	bool bInstanced = false;
+
+	/** Use the BodyInstance below instead of the actor's one */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collision")
+	bool bOverrideCollision = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Collision", meta = (EditCondition = "bOverrideCollision"))
+	FBodyInstance BodyInstance;
+};
+
+/** Components generated for one spline key interval while streaming, indices into CreatedMeshes of every layer / CreatedAdditionalMeshes */
+struct FStreamedSpan
+{
+	TArray<int32> Segments;
+	TArray<int32> Props;
+};
+
+/** Spline state at one input key, shared by every layer that has a segment boundary there */
+struct FSplineSample
+{
+	FVector Location;
+	FVector Tangent;
+	FVector Scale;
+	float Roll;
+};
+
+/** Segment keys of every layer over one key range, and the spline sampled once at the union of them */
+struct FLayerSegmentation
+{
+	TArray<TArray<float>> LayerKeys;
+	/** Sorted and unique, Samples[N] belongs to SampleKeys[N] */
+	TArray<float> SampleKeys;
+	TArray<FSplineSample> Samples;
+};
+
 USTRUCT(Blueprintable)
 struct FAdditionalMeshRepetitionParams
 {
@@ -52,6 +129,10 @@ struct FAdditionalMeshRepetitionParams
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Repetition", meta = (EditCondition = "RepeatenceType != ERepeatenceType::Always"))
 	TArray<FSplinedMeshRange> Ranges;
+
+	/** Distance in cm between meshes generated by AppendTailPoints, 0 keeps the average spacing Repetition has when streaming starts. Only used with Always */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Repetition", meta = (ClampMin = "0"))
+	float StreamingSpacing = 0.0f;
 };
 
 USTRUCT(Blueprintable)
@@ -78,6 +159,15 @@ struct FAdditionalMeshInfo
 	bool bAdjustByBounds;
 };
 
+/** Part of an additional mesh transform that only depends on its FAdditionalMeshInfo, computed once per generation */
+struct FAdditionalMeshPlacement
+{
+	/** LocationOffset, minus the scaled mesh bounds center with bAdjustByBounds */
+	FVector LocationOffset;
+	FRotator RotationOffset;
+	FVector Scale;
+};
+
 USTRUCT(Blueprintable)
 struct FAdditionalMesh
 {
@@ -94,6 +184,32 @@ struct FAdditionalMesh
 
 	UPROPERTY(EditAnywhere)
 	bool bTriggerCreationEvent;
+
+	/** Fire OnAdditionalMeshesCreated once with every new mesh of this entry instead of once per mesh */
+	UPROPERTY(EditAnywhere)
+	bool bTriggerBatchedCreationEvent;
+
+	/** Whether one of the Blueprint creation events is enabled, see AMultiMeshSpline::WantsCreationResults */
+	bool HasCreationEvent() const { return bTriggerCreationEvent || bTriggerBatchedCreationEvent; }
+};
+
+USTRUCT(BlueprintType)
+struct FAdditionalMeshCreationResult
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Result")
+	int32 Index = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Result")
+	int32 MaxIndex = 0;
+
+	/** Transform relative to the spline component */
+	UPROPERTY(BlueprintReadOnly, Category = "Result")
+	FTransform Transform;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Result")
+	TObjectPtr<UStaticMeshComponent> Component;
 };
 
 UCLASS(Blueprintable)
@@ -104,25 +220,139 @@ class SPLINEHELPER_API AMultiMeshSpline : public AActor
 public:	
 	AMultiMeshSpline();
 	virtual void OnConstruction(const FTransform& Transform) override;
+#if WITH_EDITOR
+	virtual void PostEditChangeChainProperty(FPropertyChangedChainEvent& PropertyChangedEvent) override;
+#endif
 
 protected:
-	void GenerateMeshesByPoints();
-	void GenerateMeshesByTime();
-	void GenerateMeshesBySteepness();
+	/** Segment boundaries of one layer between two input keys, KeysPerTime converts the layer's TimeInterval to keys */
+	void GatherSegmentKeys(const FSplineMeshLayer& Layer, float KeysPerTime, float StartKey, float EndKey, TArray<float>& SegmentKeys) const;
+	void GatherSegmentKeysByPoints(float StartKey, float EndKey, TArray<float>& SegmentKeys) const;
+	void GatherSegmentKeysByTime(float KeyInterval, float StartKey, float EndKey, TArray<float>& SegmentKeys) const;
+	void GatherSegmentKeysBySteepness(const FSplineMeshLayer& Layer, float KeyInterval, float StartKey, float EndKey, TArray<float>& SegmentKeys) const;
+	void GatherSegmentKeysByDeformation(const FSplineMeshLayer& Layer, float StartKey, float EndKey, TArray<float>& SegmentKeys) const;
+	void GenerateSplineMeshes();
 	void GenerateAdditionalMeshes();
 
-	void FindSteepnessPoints(float StartTime, float EndTime, float InMaxSteepness, TArray<float>& TimePoints);
-	void CreateSplineMeshSegment(float StartTime, float EndTime);
-	UStaticMeshComponent* CreateMeshAtPosition(float Position, const FAdditionalMeshInfo& MeshInfo);
-	FORCEINLINE float ConvertPointToTime(const int32 Point) const;
+	float ComputeSegmentDeformationError(float StartKey, float EndKey, float MeshRadius, bool bScaleTangents, FSplineBatchSamples& Scratch) const;
+	static float GetLayerCrossSectionRadius(const FSplineMeshLayer& Layer);
+	void SegmentLayers(const TArray<FSplineMeshLayer>& Layers, float KeysPerTime, float StartKey, float EndKey, FLayerSegmentation& OutSegmentation) const;
+	static FSplineMeshParams MakeLayerSegmentParams(const FSplineMeshLayer& Layer, const FLayerSegmentation& Segmentation, float StartKey, float EndKey);
+	static FSplineSample MakeSplineSample(const FSplineBatchSamples& BatchSamples, int32 Index);
+	static FSplineMeshParams MakeSegmentParams(float StartKey, const FSplineSample& Start, float EndKey, const FSplineSample& End, bool bScaleTangents);
+	FSplineMeshLayer MakePrimaryLayer() const;
+	const FBodyInstance& GetLayerBodyInstance(int32 LayerIndex) const;
+	void GatherMeshLayers(TArray<FSplineMeshLayer>& Layers) const;
+	USplineMeshComponent* AddSplineMeshComponent(int32 LayerIndex, EComponentMobility::Type Mobility);
+	void ApplySplineMeshLayer(USplineMeshComponent* Component, const FSplineMeshLayer& Layer, int32 LayerIndex, const FSplineMeshParams& Params);
+	void UpdateInstancedLayers(const TArray<FSplineMeshLayer>& Layers, const TArray<TArray<FSplineMeshParams>>& InstancedSegments);
+	void UpdateInstancedLayer(int32 LayerIndex, const FSplineMeshLayer& Layer, TConstArrayView<FSplineMeshParams> Segments);
+	/** Spatial index id of a segment of an instanced primary layer, negative so it never matches CreatedMeshes */
+	static int32 MakeInstancedSegmentId(int32 InstanceIndex) { return INDEX_NONE - 1 - InstanceIndex; }
+	static FAdditionalMeshPlacement MakeAdditionalMeshPlacement(const FAdditionalMeshInfo& MeshInfo);
+	void GatherAdditionalMeshPlacements(TArray<FAdditionalMeshPlacement>& Placements) const;
+	static FTransform ComputeAdditionalMeshTransform(const FVector& Location, const FVector& Tangent, const FAdditionalMeshPlacement& Placement);
+	void PlaceAdditionalMesh(UStaticMeshComponent* Component, const FTransform& Transform, const FAdditionalMeshInfo& MeshInfo);
+	void AddDirtyBounds(const UPrimitiveComponent* Component);
+	static uint32 HashSplineMeshSegment(int32 LayerIndex, const UStaticMesh* SegmentMesh, const FSplineMeshParams& Params);
+	static bool AreSplineMeshParamsEqual(const FSplineMeshParams& A, const FSplineMeshParams& B);
+	static uint32 HashAdditionalMesh(const UClass* MeshClass, const UStaticMesh* AdditionalMesh, const FVector& Location);
+	void DestroyGeneratedComponents();
+	void EnsureSpatialIndex();
+	void RegisterSpatialSegment(int32 SegmentIndex, float StartKey, float EndKey);
+	void UnregisterSpatialSegment(int32 SegmentIndex);
+	/** Registers the persisted components and keys again, copies made by PIE, cooking or loading come without an index */
+	void RestoreSpatialIndex();
+	float ConvertTimeToInputKey(float Time) const;
+	float ConvertInputKeyToTime(float InputKey) const;
+	/** Spline keys covered by one unit of Duration, segment intervals given in time are converted with it */
+	float GetKeysPerTime() const;
+
+	void BeginStreaming();
+	/** Generates the spans from FirstSpan up to EndSpan and fires the creation events of all of them together */
+	void GenerateStreamedSpans(int32 FirstSpan, int32 EndSpan);
+	void GenerateStreamedSpan(int32 SpanIndex, const TArray<FSplineMeshLayer>& Layers, const TArray<FAdditionalMeshPlacement>& Placements, TArray<TArray<FAdditionalMeshCreationResult>>& Results);
+	void RecycleStreamedSpan(FStreamedSpan& Span);
+	void RecycleStreamedSegments(FStreamedSpan& Span);
+	void RecycleStreamedProps(FStreamedSpan& Span);
+	int32 AcquireStreamedSegment(int32 LayerIndex);
+	int32 AcquireStreamedProp(UClass* MeshClass);
+	void NotifyAdditionalMeshesCreated(const TArray<TArray<FAdditionalMeshCreationResult>>& Results);
+
+	/** True when a generated component was destroyed or belongs to another actor */
+	bool HasStaleGeneratedComponents() const;
+	/** Hash of the spline data and every generation setting, collision settings excluded */
+	uint32 ComputeInputFingerprint() const;
+	static void HashPropertyValue(const FProperty* Property, const void* Value, uint32& Hash);
+	static bool IsCollisionProperty(const FProperty* Property);
 
 public:
+	/**
+	 * Fired for every component the last generation created, kept components don't fire again.
+	 * Components of entries with a creation event are only kept while their Index and MaxIndex stay the same.
+	 * Streamed props are pooled, while streaming CreatedMesh can be a recycled component of the same class.
+	 */
 	UFUNCTION(BlueprintImplementableEvent)
 	void OnAdditionalMeshCreated(int32 Index, int32 MaxIndex, const FName& Name, UStaticMeshComponent* CreatedMesh);
 
+	UFUNCTION(BlueprintImplementableEvent)
+	void OnAdditionalMeshesCreated(const FName& Name, const TArray<FAdditionalMeshCreationResult>& Results);
+
+	/** Called once per AdditionalMeshSettings entry that WantsCreationResults after its meshes were created, override to post process them without going through Blueprint */
+	virtual void NativeOnAdditionalMeshesCreated(const FAdditionalMesh& Settings, const TArray<FAdditionalMeshCreationResult>& Results);
+
+	/** Creation results are only gathered for entries this returns true for, override together with NativeOnAdditionalMeshesCreated to get them without enabling a Blueprint event */
+	virtual bool WantsCreationResults(const FAdditionalMesh& Settings) const { return Settings.HasCreationEvent(); }
+
 	UFUNCTION(BlueprintCallable)
 	void UpdateCollisionInfo();
 
+	/** Closest point on the spline to a world location, uses the spatial index built during generation */
+	UFUNCTION(BlueprintCallable, Category = "Spline Queries")
+	FVector FindClosestPointOnSpline(const FVector& WorldLocation, float& OutTime);
+
+	/** nullptr when the primary layer is instanced */
+	UFUNCTION(BlueprintCallable, Category = "Spline Queries")
+	USplineMeshComponent* FindSegmentClosestToLocation(const FVector& WorldLocation);
+
+	/** nullptr when the primary layer is instanced */
+	UFUNCTION(BlueprintCallable, Category = "Spline Queries")
+	USplineMeshComponent* FindSegmentAtTime(float Time);
+
+	UFUNCTION(BlueprintCallable, Category = "Spline Queries")
+	TArray<UStaticMeshComponent*> FindAdditionalMeshesInRadius(const FVector& WorldLocation, float Radius);
+
+	/**
+	 * Adds points to the end of the spline and only generates the segments and props of the new key intervals.
+	 * The first call, or the first TrimHeadPoints, switches the actor to streaming and regenerates every component span by span:
+	 * every layer segments each key interval with its own SplineType, TimeInterval covering as many keys as it did when
+	 * streaming started. Instanced layers get spline mesh components, and only additional meshes with Always repetition
+	 * are placed, every StreamingSpacing cm. Refresh leaves streaming.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spline Streaming")
+	void AppendTailPoints(const TArray<FVector>& Points, ESplineCoordinateSpace::Type CoordinateSpace = ESplineCoordinateSpace::Local);
+
+	/** Removes points from the start of the spline, their components are hidden and reused by the next AppendTailPoints */
+	UFUNCTION(BlueprintCallable, Category = "Spline Streaming")
+	void TrimHeadPoints(int32 NumPoints);
+
+	/** Logs segment count, generation time and worst deformation error of every segmentation mode */
+	UFUNCTION(CallInEditor, Category = "Spline Mesh")
+	void CompareSegmentationModes();
+
+	/** Logs the time to sample the spline through USplineComponent and through FSplineBatchEvaluator, and their largest difference */
+	UFUNCTION(CallInEditor, Category = "Spline Mesh")
+	void BenchmarkSplineEvaluation();
+
+	/** Logs draw calls and a lower bound of the memory of every layer rendered as spline mesh components and as instances */
+	UFUNCTION(CallInEditor, Category = "Spline Mesh")
+	void LogInstancingStats();
+
+	/** World space union of the bounds of every component the last Refresh added, changed or removed, invalid when nothing changed */
+	UFUNCTION(BlueprintPure, Category = "Spline Mesh")
+	FBox GetLastRefreshDirtyBounds() const { return LastRefreshDirtyBounds; }
+
+	/** Regenerates the components, the ones whose segment or prop is unchanged are kept untouched */
 	void Refresh();
 
 	virtual void Tick(float DeltaTime) override;
@@ -143,16 +373,78 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	TEnumAsByte<ESplineMeshType> SplineType;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "SplineType != ESplineMeshType::Point", ClampMin = "0.001", UIMin = "0.001"))
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "SplineType == ESplineMeshType::TimeBased || SplineType == ESplineMeshType::Steepness", ClampMin = "0.001", UIMin = "0.001"))
 	float TimeInterval = 0.1;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "SplineType == ESplineMeshType::Steepness", ClampMin = "0.5", UIMin = "0.5"))
 	float MaxSteepnessThreshold = 20;
 
+	/** Maximum distance in cm between the deformed mesh and the spline, roll and scale errors are measured at the mesh cross section radius */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "SplineType == ESplineMeshType::Deformation", ClampMin = "0.01", UIMin = "0.01"))
+	float DeformationTolerance = 1.0f;
+
+	/** Render Mesh as instances, see FSplineMeshLayer::bInstanced */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bInstanced = false;
+
+	/** Extra deforming meshes generated along the same spline as Mesh, e.g. curbs, guardrails or drainage */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TArray<FSplineMeshLayer> MeshLayers;
+
 private:
+	static constexpr int32 DeformationErrorSamples = 8;
+	/** Fraction of a spline key the deformation search refines a segment end to */
+	static constexpr float DeformationSearchResolution = 1e-3f;
+	/** Deformation segments never cross a multiple of this many keys, edits further away keep their boundaries */
+	static constexpr int32 DeformationResyncKeys = 16;
+
 	UPROPERTY()
 	TArray<USplineMeshComponent*> CreatedMeshes;
 
+	/** Layer of every entry in CreatedMeshes, 0 is the primary Mesh and N is MeshLayers[N - 1] */
+	UPROPERTY()
+	TArray<int32> CreatedMeshLayers;
+
 	UPROPERTY()
 	TArray<UStaticMeshComponent*> CreatedAdditionalMeshes;
+
+	/** Index and MaxIndex the creation events reported for every entry in CreatedAdditionalMeshes */
+	UPROPERTY()
+	TArray<FIntPoint> CreatedAdditionalMeshIndices;
+
+	/** Instanced static mesh of every layer with bInstanced, indexed by layer and null for the others */
+	UPROPERTY()
+	TArray<UInstancedStaticMeshComponent*> CreatedInstancedLayers;
+
+	/** Input keys of every entry in CreatedMeshes registered in the spatial index, X is negative for the others. Stored without CreatedKeyOffset */
+	UPROPERTY()
+	TArray<FVector2f> CreatedMeshKeys;
+
+	/** Input keys of every instance of an instanced primary layer, stored without CreatedKeyOffset */
+	UPROPERTY()
+	TArray<FVector2f> CreatedInstancedKeys;
+
+	/** Keys removed by TrimHeadPoints since the components were generated */
+	UPROPERTY()
+	float CreatedKeyOffset = 0.0f;
+
+	FSplineSpatialIndex SpatialIndex;
+
+	/** Fingerprint of the inputs the current components were generated from, 0 forces the next construction to rebuild */
+	uint32 GeneratedFingerprint = 0;
+	bool bPendingCollisionUpdate = false;
+	FBox LastRefreshDirtyBounds = FBox(ForceInit);
+
+	bool bStreaming = false;
+	/** Live spans start at StreamedSpanHead, the ones before it were trimmed and are waiting for compaction */
+	TArray<FStreamedSpan> StreamedSpans;
+	int32 StreamedSpanHead = 0;
+	/** Distance grid offset accumulated by TrimHeadPoints, keeps the props of the kept spans in place */
+	double TrimmedDistance = 0.0;
+	TArray<TArray<int32>> FreeSegmentsByLayer;
+	/** Prop spacing of every AdditionalMeshSettings entry while streaming, 0 skips it */
+	TArray<double> StreamingSpacings;
+	/** GetKeysPerTime when streaming started, keeps TimeInterval covering the same number of keys as the spline grows */
+	float StreamingKeysPerTime = 0.0f;
+	TMap<UClass*, TArray<int32>> FreePropsByClass;
 };
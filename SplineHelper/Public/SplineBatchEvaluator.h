@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class USplineComponent;
+
+/** Local space spline state at a batch of times, Rolls are in degrees */
+struct FSplineBatchSamples
+{
+	TArray<FVector> Locations;
+	TArray<FVector> Tangents;
+	TArray<FVector> Scales;
+	TArray<float> Rolls;
+	/** Keys EvaluateAtTimes converted the times to, a batch reused across calls doesn't allocate once it is large enough */
+	TArray<float> InputKeys;
+
+	int32 Num() const { return Locations.Num(); }
+};
+
+/**
+ * Evaluates the curves of a spline at many sorted times in one pass.
+ * The curve point of the first sample is found by binary search and the following samples walk forward from it,
+ * so a batch costs one search plus the points it covers, and the hermite basis of the position curve is evaluated
+ * four samples at a time with vector registers.
+ * Results match USplineComponent::Get*AtTime without constant velocity / Get*AtSplineInputKey in local space.
+ * Sorted input is checked in debug builds only, elsewhere unsorted input is still evaluated correctly, just slower.
+ */
+class SPLINEHELPER_API FSplineBatchEvaluator
+{
+public:
+	/** InputKeys must be sorted ascending */
+	static void EvaluateAtInputKeys(const USplineComponent* Spline, TConstArrayView<float> InputKeys, FSplineBatchSamples& OutSamples);
+
+	/** Times must be sorted ascending */
+	static void EvaluateAtTimes(const USplineComponent* Spline, TConstArrayView<float> Times, FSplineBatchSamples& OutSamples);
+
+	/** Only location and tangent, InputKeys must be sorted ascending */
+	static void EvaluatePositionsAtInputKeys(const USplineComponent* Spline, TConstArrayView<float> InputKeys, TArray<FVector>& OutLocations, TArray<FVector>& OutTangents);
+
+	/** Only location and tangent, Times must be sorted ascending */
+	static void EvaluatePositionsAtTimes(const USplineComponent* Spline, TConstArrayView<float> Times, TArray<FVector>& OutLocations, TArray<FVector>& OutTangents);
+
+	/** Reference path through USplineComponent, one key search and space transform per call */
+	static void EvaluateAtTimesScalar(const USplineComponent* Spline, TConstArrayView<float> Times, FSplineBatchSamples& OutSamples);
+
+private:
+	static void ConvertTimesToInputKeys(const USplineComponent* Spline, TConstArrayView<float> Times, TArray<float>& OutInputKeys);
+	static void EvaluateVectorCurve(const FInterpCurveVector& Curve, TConstArrayView<float> InputKeys, const FVector& Default, TArray<FVector>& OutValues, TArray<FVector>* OutDerivatives);
+
+	static constexpr int32 LaneCount = 4;
+};
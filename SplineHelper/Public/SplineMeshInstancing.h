@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FSplineMeshParams;
+
+/**
+ * Packs spline mesh segments into instances of one instanced static mesh.
+ * Every instance sits at the middle of its segment and carries the segment in its per instance custom data,
+ * Shaders/SplineMeshInstancing.ush deforms the mesh from it the same way USplineMeshComponent does (forward axis X, up Z).
+ * Only positions are deformed, normals and tangents keep the direction they have on the straight mesh.
+ *
+ * Custom data layout, positions relative to the instance:
+ * 0-2 start position, 3-5 start tangent, 6-8 end position, 9-11 end tangent,
+ * 12-13 start scale, 14-15 end scale, 16 start roll, 17 end roll (radians),
+ * 18-19 start offset, 20-21 end offset, 22 mesh min X, 23 one over the mesh length along X.
+ */
+struct SPLINEHELPER_API FSplineMeshInstancePacker
+{
+	static constexpr int32 NumCustomDataFloats = 24;
+
+	struct FPackedSegments
+	{
+		TArray<FTransform> Transforms;
+		TArray<float> CustomData;
+		/** Bounds scale the component needs so its bounds cover every deformed segment, per instance culling still needs the material's Max World Position Offset Displacement */
+		float BoundsScale = 1.0f;
+	};
+
+	/** Draw calls and a lower bound of the memory of a layer rendered as spline mesh components and as instances */
+	struct FStats
+	{
+		int32 NumSegments = 0;
+		int32 ComponentDrawCalls = 0;
+		int32 InstancedDrawCalls = 0;
+		int64 ComponentBytes = 0;
+		int64 InstancedBytes = 0;
+	};
+
+	static FTransform PackSegment(const FSplineMeshParams& Params, const FBox& MeshBounds, TArrayView<float> OutCustomData);
+	static void PackSegments(TConstArrayView<FSplineMeshParams> Segments, const FBox& MeshBounds, FPackedSegments& OutPacked);
+
+	/** Reference of the material deformation, moves a vertex of the undeformed mesh to its place relative to the instance */
+	static FVector DeformPosition(TConstArrayView<float> CustomData, const FVector& MeshPosition);
+
+	/** Memory is a lower bound from object sizes, render proxies, body instances and GPU buffers are not included */
+	static FStats ComputeStats(int32 NumSegments, int32 NumMeshSections);
+
+private:
+	static float ComputeBoundsScale(TConstArrayView<float> CustomData, const FBox& MeshBounds);
+
+	/** Mesh slices sampled along X by ComputeBoundsScale */
+	static constexpr int32 BoundsSlices = 8;
+};
@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Polyline simplifier that works on a stream of points.
+ * A point is only emitted when skipping it would move the polyline further than the tolerance,
+ * so the dense input never has to be stored.
+ */
+class SPLINEHELPER_API FStreamingPolylineSimplifier
+{
+public:
+	FStreamingPolylineSimplifier(float InTolerance, TFunction<void(const FVector&)> InEmitPoint);
+
+	void AddPoint(const FVector& Point);
+	void Finish();
+
+	int32 GetNumPointsRead() const { return NumPointsRead; }
+	int32 GetNumPointsEmitted() const { return NumPointsEmitted; }
+
+private:
+	void Emit(const FVector& Point);
+	bool IsWindowWithinTolerance(const FVector& Candidate) const;
+
+private:
+	/** Upper bound for the pending window, keeps memory and per point cost bounded on long straight runs */
+	static constexpr int32 MaxWindowSize = 1024;
+
+	float ToleranceSquared;
+	TFunction<void(const FVector&)> EmitPoint;
+
+	FVector Anchor = FVector::ZeroVector;
+	bool bHasAnchor = false;
+	TArray<FVector> Window;
+
+	int32 NumPointsRead = 0;
+	int32 NumPointsEmitted = 0;
+};
+
+/**
+ * Reads point files chunk by chunk (memory mapped where the platform supports it).
+ *
+ * Supported formats:
+ * - CSV / text: one "X,Y,Z" triple per line, ',', ';', tabs and spaces are accepted as separators,
+ *   lines that don't start with three numbers (headers, comments) are skipped.
+ * - Binary (.spts): uint32 magic 'SPTS', uint32 version, followed by packed little endian float32 XYZ triples.
+ */
+struct SPLINEHELPER_API FSplinePointImporter
+{
+	static constexpr uint32 BinaryMagic = 0x53545053;
+	static constexpr uint32 BinaryVersion = 1;
+	static constexpr int64 ChunkSize = 4 * 1024 * 1024;
+
+	static bool ImportFile(const FString& FilePath, TFunctionRef<void(const FVector&)> OnPoint);
+
+private:
+	static bool ReadChunks(const FString& FilePath, TFunctionRef<bool(const uint8*, int64)> OnChunk);
+	static bool ParseTextLine(const ANSICHAR* Line, int32 Length, FVector& OutPoint);
+};
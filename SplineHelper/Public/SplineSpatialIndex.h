@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class USplineComponent;
+
+/**
+ * Bounding volume hierarchy over the generated segments and props of a spline.
+ * Everything is stored in the local space of the spline component, segments are described by spline input keys.
+ * Entries can be added and removed at any time, Build only samples and indexes the ones added since the previous Build.
+ */
+class SPLINEHELPER_API FSplineSpatialIndex
+{
+public:
+	struct FClosestPointResult
+	{
+		FVector Location = FVector::ZeroVector;
+		float InputKey = 0.0f;
+		int32 SegmentIndex = INDEX_NONE;
+	};
+
+	void Reset();
+
+	void AddSegment(int32 SegmentIndex, float StartKey, float EndKey);
+	void RemoveSegment(int32 SegmentIndex);
+	void AddProp(int32 PropIndex, const FVector& Location);
+	void RemoveProp(int32 PropIndex);
+
+	/** Moves every registered segment by Delta keys, used when points are removed from the start of the spline */
+	void ShiftKeys(float Delta);
+
+	/** Samples the segments added since the last Build and inserts them and the new props into the hierarchies */
+	void Build(const USplineComponent* Spline);
+
+	bool FindClosestPoint(const USplineComponent* Spline, const FVector& Location, FClosestPointResult& OutResult) const;
+	int32 FindSegmentAtInputKey(float InputKey) const;
+	void FindPropsInRadius(const FVector& Location, float Radius, TArray<int32>& OutPropIndices) const;
+
+	bool IsBuilt() const { return bBuilt; }
+	bool IsEmpty() const { return SegmentsById.IsEmpty() && PropSlotsById.IsEmpty(); }
+
+private:
+	/** Node of a flattened hierarchy, leaves reference a range of items, inner nodes their first child (the second one follows it) */
+	struct FNode
+	{
+		FBox Bounds;
+		int32 First = 0;
+		int32 Count = 0;
+	};
+
+	struct FHierarchy
+	{
+		TArray<FNode> Nodes;
+		TArray<int32> Items;
+
+		void Build(const TArray<FBox>& ItemBounds, TArray<int32>&& InItems);
+		void BuildNode(const TArray<FBox>& ItemBounds, int32 NodeIndex, int32 Begin, int32 End);
+
+		/**
+		 * Adds items to a list of hierarchies with decreasing sizes. The new items are merged with the smaller hierarchies
+		 * into one, so every item is rebuilt a logarithmic number of times. Removed items are dropped while merging.
+		 */
+		static void Insert(TArray<FHierarchy>& Hierarchies, const TArray<FBox>& ItemBounds, TArray<int32>&& NewItems, TFunctionRef<bool(int32)> IsAlive);
+	};
+
+	/** Chord between two samples of a segment, SegmentIndex is INDEX_NONE once the segment was removed */
+	struct FSample
+	{
+		FVector Start;
+		FVector End;
+		float StartKey;
+		float EndKey;
+		int32 SegmentIndex;
+	};
+
+	struct FSegment
+	{
+		float StartKey;
+		float EndKey;
+		int32 SegmentIndex;
+		/** SamplesPerSegment consecutive entries of Samples, INDEX_NONE until the next Build */
+		int32 FirstSample = INDEX_NONE;
+	};
+
+	/** PropIndex is INDEX_NONE once the prop was removed */
+	struct FProp
+	{
+		FVector Location;
+		int32 PropIndex;
+	};
+
+	void SampleSegment(const USplineComponent* Spline, FSegment& Segment, TArray<int32>& OutNewSamples);
+	/** Drops removed samples and props and rebuilds their hierarchy from the remaining ones */
+	void CompactSamples();
+	void CompactProps();
+
+	/** Whole stored key interval a key belongs to */
+	static int32 GetKeyBucket(float StoredKey) { return FMath::FloorToInt32(StoredKey); }
+
+	static constexpr int32 SamplesPerSegment = 8;
+	static constexpr int32 MaxLeafSize = 4;
+	static constexpr int32 RefineIterations = 12;
+
+	/** Registered entries, keys are stored without KeyOffset */
+	TMap<int32, FSegment> SegmentsById;
+	TMap<int32, int32> PropSlotsById;
+	float KeyOffset = 0.0f;
+
+	/** Ids of the segments overlapping every whole stored key interval, adding or removing a segment only touches its own intervals */
+	TMap<int32, TArray<int32, TInlineAllocator<2>>> SegmentIdsByKey;
+	TArray<int32> UnsampledSegments;
+
+	TArray<FSample> Samples;
+	TArray<FBox> SampleBounds;
+	int32 NumRemovedSamples = 0;
+
+	TArray<FProp> Props;
+	TArray<FBox> PropBounds;
+	TArray<int32> UnindexedProps;
+	int32 NumRemovedProps = 0;
+
+	TArray<FHierarchy> SampleHierarchies;
+	TArray<FHierarchy> PropHierarchies;
+
+	bool bBuilt = false;
+};
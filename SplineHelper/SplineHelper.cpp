@@ -1,8 +1,14 @@
 #include "SplineHelper.h"
 
+#include "AdaptiveSplineComponent.h"
 #include "AdaptiveSplineDetails.h"
+#include "AdaptiveSplineVisualizer.h"
+#include "UnrealEdGlobals.h"
+#include "Editor/UnrealEdEngine.h"
+#include "SplineHelperLog.h"
 #include "Modules/ModuleManager.h"
 
+DEFINE_LOG_CATEGORY(LogSplineHelper);
 
 void FSplineHelper::StartupModule()
 {
@@ -11,10 +17,22 @@ void FSplineHelper::StartupModule()
 		"AdaptiveSplineComponent",
 		FOnGetDetailCustomizationInstance::CreateStatic(&FAdaptiveSplineDetails::MakeInstance)
 	);
+
+	if (GUnrealEd)
+	{
+		const TSharedPtr<FComponentVisualizer> Visualizer = MakeShareable(new FAdaptiveSplineVisualizer());
+		GUnrealEd->RegisterComponentVisualizer(UAdaptiveSplineComponent::StaticClass()->GetFName(), Visualizer);
+		Visualizer->OnRegister();
+	}
 }
 
 void FSplineHelper::ShutdownModule()
 {
+	if (GUnrealEd)
+	{
+		GUnrealEd->UnregisterComponentVisualizer(UAdaptiveSplineComponent::StaticClass()->GetFName());
+	}
+
 	if (FModuleManager::Get().IsModuleLoaded("PropertyEditor"))
 	{
 		FPropertyEditorModule& PropertyModule = FModuleManager::GetModuleChecked<FPropertyEditorModule>("PropertyEditor");